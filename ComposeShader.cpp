@@ -0,0 +1,176 @@
+#include "include/GShader.h"
+#include "include/GMatrix.h"
+
+#include "GBlend.h"
+#include "GTools.h"
+
+// Whether blending src onto dst with the mode always produces opaque pixels.
+static bool blendIsOpaque(GBlendMode mode, bool srcOpaque, bool dstOpaque){
+    switch(mode){
+        case GBlendMode::kSrc:     return srcOpaque;
+        case GBlendMode::kDst:     return dstOpaque;
+        case GBlendMode::kSrcOver:
+        case GBlendMode::kDstOver: return srcOpaque || dstOpaque;
+        case GBlendMode::kSrcIn:
+        case GBlendMode::kDstIn:   return srcOpaque && dstOpaque;
+        case GBlendMode::kSrcATop: return dstOpaque;
+        case GBlendMode::kDstATop: return srcOpaque;
+        default:                   return false;
+    }
+}
+
+/**
+ *  Base for shaders built from two others. The first shader shades straight into the caller's
+ *  row; the second shades into a scratch row owned by this shader, and the two are combined in
+ *  place, so no intermediate bitmap is ever needed.
+ */
+class GPairShader : public GShader {
+public:
+    GPairShader(GShader* first, GShader* second) : fFirst(first), fSecond(second) {}
+
+    bool setContext(const GMatrix& ctm) override {
+        bool success = fFirst->setContext(ctm);
+        return fSecond->setContext(ctm) && success;
+    }
+
+    bool setContext(const GMatrix& ctm, const GMatrix& inverse) override {
+        bool success = fFirst->setContext(ctm, inverse);
+        return fSecond->setContext(ctm, inverse) && success;
+    }
+
+    int invariance() override {
+        return fFirst->invariance() & fSecond->invariance();
+    }
+
+    void shadeRow(int x, int y, int count, GPixel row[]) override {
+        if(fScratch.size() < (size_t)count)
+            fScratch.resize(count);
+        fFirst->shadeRow(x, y, count, row);
+        fSecond->shadeRow(x, y, count, fScratch.data());
+        combine(row, fScratch.data(), count);
+    }
+
+protected:
+    // Combine the first shader's output (in row) with the second's (in other), into row.
+    virtual void combine(GPixel row[], const GPixel other[], int count) = 0;
+
+    GShader* fFirst;
+    GShader* fSecond;
+
+private:
+    std::vector<GPixel> fScratch;
+};
+
+class GMultiplyShader : public GPairShader {
+public:
+    GMultiplyShader(GShader* a, GShader* b) : GPairShader(a, b) {}
+
+    bool isOpaque() override {
+        return fFirst->isOpaque() && fSecond->isOpaque();
+    }
+
+protected:
+    void combine(GPixel row[], const GPixel other[], int count) override {
+        for(int i = 0; i < count; ++i)
+            row[i] = multiplyPixel(row[i], other[i]);
+    }
+};
+
+class GComposeShader : public GPairShader {
+public:
+    GComposeShader(GShader* dst, GShader* src, GBlendMode mode) : GPairShader(dst, src), fMode(mode) {
+        fRowProc = blendRowProc(mode, false);
+    }
+
+    bool isOpaque() override {
+        return blendIsOpaque(fMode, fSecond->isOpaque(), fFirst->isOpaque());
+    }
+
+protected:
+    void combine(GPixel row[], const GPixel other[], int count) override {
+        fRowProc(row, other, count, 255);
+    }
+
+private:
+    GBlendMode fMode;
+    BlendRowProc fRowProc;
+};
+
+class GColorFilterShader : public GShader {
+public:
+    GColorFilterShader(GShader* shader, const GColor& color, GBlendMode mode)
+        : fShader(shader), fPixel(makePixel(color.pinToUnit())), fMode(mode) {
+        fProc = changeBlend(fPixel, mode);
+    }
+
+    bool isOpaque() override {
+        return blendIsOpaque(fMode, GPixel_GetA(fPixel) == 255, fShader->isOpaque());
+    }
+
+    bool setContext(const GMatrix& ctm) override { return fShader->setContext(ctm); }
+    bool setContext(const GMatrix& ctm, const GMatrix& inverse) override { return fShader->setContext(ctm, inverse); }
+
+    int invariance() override { return fShader->invariance(); }
+
+    void shadeRow(int x, int y, int count, GPixel row[]) override {
+        fShader->shadeRow(x, y, count, row);
+        if(fProc == kDst)
+            return;
+        for(int i = 0; i < count; ++i)
+            row[i] = fProc(fPixel, row[i]);
+    }
+
+private:
+    GShader* fShader;
+    GPixel fPixel;
+    GBlendMode fMode;
+    BlendProc fProc;
+};
+
+class GAlphaShader : public GShader {
+public:
+    GAlphaShader(GShader* shader, float alpha) : fShader(shader), fScale(GRoundToInt(GPinToUnit(alpha) * 255)) {}
+
+    bool isOpaque() override { return fScale == 255 && fShader->isOpaque(); }
+
+    bool setContext(const GMatrix& ctm) override { return fShader->setContext(ctm); }
+    bool setContext(const GMatrix& ctm, const GMatrix& inverse) override { return fShader->setContext(ctm, inverse); }
+
+    int invariance() override { return fShader->invariance(); }
+
+    void shadeRow(int x, int y, int count, GPixel row[]) override {
+        fShader->shadeRow(x, y, count, row);
+        if(fScale == 255)
+            return;
+        for(int i = 0; i < count; ++i)
+            row[i] = scalePixel(row[i], fScale);
+    }
+
+private:
+    GShader* fShader;
+    unsigned fScale;
+};
+
+std::unique_ptr<GShader> GCreateMultiplyShader(GShader* a, GShader* b){
+    if(!a || !b)
+        return nullptr;
+    return std::unique_ptr<GShader>(new GMultiplyShader(a, b));
+}
+
+std::unique_ptr<GShader> GCreateComposeShader(GShader* dst, GShader* src, GBlendMode mode){
+    if(!dst || !src)
+        return nullptr;
+    return std::unique_ptr<GShader>(new GComposeShader(dst, src, mode));
+}
+
+std::unique_ptr<GShader> GCreateColorFilterShader(GShader* shader, const GColor& color, GBlendMode mode){
+    if(!shader)
+        return nullptr;
+    return std::unique_ptr<GShader>(new GColorFilterShader(shader, color, mode));
+}
+
+std::unique_ptr<GShader> GCreateAlphaShader(GShader* shader, float alpha){
+    if(!shader)
+        return nullptr;
+    return std::unique_ptr<GShader>(new GAlphaShader(shader, alpha));
+}
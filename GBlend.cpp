@@ -147,6 +147,95 @@ BlendProc changeBlend(GPixel source, GBlendMode mode){
     //make third list for alpha==255
 }
 
+// Blend a run of pixels that all take the same proc.
+template <BlendProc proc> static inline void blendRun(GPixel dst[], const GPixel src[], int count){
+    if(proc == kDst)
+        return;
+    for(int i = 0; i < count; ++i)
+        dst[i] = proc(src[i], dst[i]);
+}
+
+// Every proc in the "color" table is correct for any src alpha, so scaled rows use it throughout.
+template <BlendProc proc> static void blendScaledRow(GPixel dst[], const GPixel src[], int count, unsigned alpha){
+    if(proc == kDst)
+        return;
+    for(int i = 0; i < count; ++i){
+        GPixel scaled = scalePixel(src[i], alpha);
+        dst[i] = proc(scaled, dst[i]);
+    }
+}
+
+template <BlendProc zero, BlendProc opaque, BlendProc partial>
+static void blendRow(GPixel dst[], const GPixel src[], int count, unsigned alpha){
+    if(alpha != 255){
+        blendScaledRow<partial>(dst, src, count, alpha);
+        return;
+    }
+    int i = 0;
+    while(i < count){
+        int start = i;
+        unsigned a = GPixel_GetA(src[i]);
+        if(a == 0){
+            do ++i; while(i < count && GPixel_GetA(src[i]) == 0);
+            blendRun<zero>(dst + start, src + start, i - start);
+        }
+        else if(a == 255){
+            do ++i; while(i < count && GPixel_GetA(src[i]) == 255);
+            blendRun<opaque>(dst + start, src + start, i - start);
+        }
+        else{
+            do ++i; while(i < count && (unsigned)(GPixel_GetA(src[i]) - 1) < 254);
+            blendRun<partial>(dst + start, src + start, i - start);
+        }
+    }
+}
+
+template <BlendProc opaque, BlendProc partial>
+static void blendOpaqueRow(GPixel dst[], const GPixel src[], int count, unsigned alpha){
+    if(alpha != 255){
+        blendScaledRow<partial>(dst, src, count, alpha);
+        return;
+    }
+    blendRun<opaque>(dst, src, count);
+}
+
+// Indexed by GBlendMode, pairing the procs of the noColor, opaqueColor and color tables.
+static const BlendRowProc rowProcs[12] = {
+    blendRow<kClear, kClear,   kClear>,
+    blendRow<kClear, kSrc,     kSrc>,
+    blendRow<kDst,   kDst,     kDst>,
+    blendRow<kDst,   kSrc,     kSrcOver>,
+    blendRow<kDst,   kDstOver, kDstOver>,
+    blendRow<kClear, kSrcIn,   kSrcIn>,
+    blendRow<kClear, kDst,     kDstIn>,
+    blendRow<kClear, kSrcOut,  kSrcOut>,
+    blendRow<kDst,   kClear,   kDstOut>,
+    blendRow<kDst,   kSrcIn,   kSrcATop>,
+    blendRow<kClear, kDstATop, kDstATop>,
+    blendRow<kDst,   kSrcOut,  kXor>,
+};
+
+static const BlendRowProc opaqueRowProcs[12] = {
+    blendOpaqueRow<kClear,   kClear>,
+    blendOpaqueRow<kSrc,     kSrc>,
+    blendOpaqueRow<kDst,     kDst>,
+    blendOpaqueRow<kSrc,     kSrcOver>,
+    blendOpaqueRow<kDstOver, kDstOver>,
+    blendOpaqueRow<kSrcIn,   kSrcIn>,
+    blendOpaqueRow<kDst,     kDstIn>,
+    blendOpaqueRow<kSrcOut,  kSrcOut>,
+    blendOpaqueRow<kClear,   kDstOut>,
+    blendOpaqueRow<kSrcIn,   kSrcATop>,
+    blendOpaqueRow<kDstATop, kDstATop>,
+    blendOpaqueRow<kSrcOut,  kXor>,
+};
+
+BlendRowProc blendRowProc(GBlendMode mode, bool srcOpaque){
+    if(srcOpaque)
+        return opaqueRowProcs[static_cast<int>(mode)];
+    return rowProcs[static_cast<int>(mode)];
+}
+
 void blit(const GPixel* src, GBitmap canvas, int top, int bottom, int left, int right, BlendProc proc) {
     for(int y = top; y < bottom; ++y)
         for(int x = left; x < right; ++x){
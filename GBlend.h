@@ -1,3 +1,6 @@
+#ifndef GBlend_DEFINED
+#define GBlend_DEFINED
+
 #include "include/GPixel.h"
 #include "include/GBlendMode.h"
 #include "include/GBitmap.h"
@@ -6,6 +9,15 @@ typedef GPixel (*BlendProc)(const GPixel& src, GPixel& dst);
 BlendProc changeBlend(GPixel source, GBlendMode mode);
 void blit(const GPixel* src, GBitmap canvas, int top, int bottom, int left, int right, BlendProc proc);
 
+/**
+ *  Blends count src pixels onto dst, scaling src by alpha (0...255) first. Row procs pick the
+ *  pixel proc per run of transparent, opaque or partial src pixels rather than per pixel.
+ */
+typedef void (*BlendRowProc)(GPixel dst[], const GPixel src[], int count, unsigned alpha);
+
+// Return the row proc for the mode. If srcOpaque, every src pixel must have alpha 255.
+BlendRowProc blendRowProc(GBlendMode mode, bool srcOpaque);
+
 GPixel(kClear)(const GPixel& src, GPixel& dst);
 GPixel(kSrc)(const GPixel& src, GPixel& dst);
 GPixel(kDst)(const GPixel& src, GPixel& dst);
@@ -63,3 +75,5 @@ static const BlendProc color[12] = {
     kDstATop,
     kXor
 };
+
+#endif
@@ -1,4 +1,6 @@
-#include <stack>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "include/GCanvas.h"
 #include "include/GShader.h"
@@ -7,24 +9,66 @@
 
 #include "GBlend.h"
 #include "GEdge.h"
+#include "GHairline.h"
 #include "GLinearGradient.h"
-#include "ProxyShader.h"
+#include "GTexture.h"
+#include "GTriangle.h"
 
 
 class MyCanvas : public GCanvas {
 public:
-    MyCanvas(const GBitmap& device) : fDevice(device) {fCTM = std::stack<GMatrix>(); fCTM.push(GMatrix());}
+    MyCanvas(const GBitmap& device) : fDevice(device), fRow(device.width()), fColorRow(device.width()) {
+        fStates.reserve(kReservedStates);
+        fStates.push_back({GMatrix(), GMatrix(), true, true});
+    }
     
     void save(){
-        fCTM.push(fCTM.top());
+        fStates.push_back(fStates.back());
     }
 
     void restore(){
-        fCTM.pop();
+        if(!fLayers.empty() && fLayers.back().depth == fStates.size())
+            restoreLayer();
+        fStates.pop_back();
+    }
+
+    void saveLayer(const GRect* bounds, const GPaint& source) override{
+        GIRect area = GIRect::WH(fDevice.width(), fDevice.height());
+        if(bounds != nullptr){
+            GPoint corners[4] = {{bounds->left(), bounds->top()}, {bounds->right(), bounds->top()},
+                                 {bounds->right(), bounds->bottom()}, {bounds->left(), bounds->bottom()}};
+            GPoint mapped[4];
+            getCTM().mapPoints(mapped, corners, 4);
+            GRect box = GRect::LTRB(mapped[0].x(), mapped[0].y(), mapped[0].x(), mapped[0].y());
+            for(const GPoint& pt : mapped)
+                box = GRect::LTRB(std::min(box.left(), pt.x()), std::min(box.top(), pt.y()),
+                                  std::max(box.right(), pt.x()), std::max(box.bottom(), pt.y()));
+            GIRect r = box.round();
+            area = GIRect::LTRB(std::max(r.left(), 0), std::max(r.top(), 0),
+                                std::min(r.right(), fDevice.width()), std::min(r.bottom(), fDevice.height()));
+        }
+        save();
+
+        Layer layer;
+        layer.parent = fDevice;
+        layer.depth = fStates.size();
+        layer.alpha = GRoundToInt(GPinToUnit(source.getAlpha()) * 255);
+        layer.mode = source.getBlendMode();
+        //a layer with nothing to cover still needs pixels to draw (and discard) into
+        layer.empty = area.isEmpty();
+        if(layer.empty)
+            area = GIRect::WH(1, 1);
+        layer.left = area.left();
+        layer.top = area.top();
+        layer.pixels = takeLayerPixels(area.width() * area.height());
+
+        fDevice = GBitmap(area.width(), area.height(), area.width() * sizeof(GPixel), layer.pixels.data(), false);
+        setCTM(GMatrix::Translate(-area.left(), -area.top()) * getCTM());
+        fLayers.push_back(std::move(layer));
     }
 
     void concat(const GMatrix& matrix){
-        fCTM.top() = fCTM.top() * matrix;
+        setCTM(getCTM() * matrix);
     }
 
     void drawPaint(const GPaint& source) override{
@@ -55,14 +99,10 @@ public:
         int32_t right = intRect.right();
         int32_t bottom = intRect.bottom();
 
-        BlendProc ptr;
-        GPixel srcPixel = makePixel(source.getColor());
-        GShader* shader = source.getShader();
-
         //transform points
         GPoint points[4] = {{left, top}, {right, top}, {right, bottom}, {left, bottom}};
         GPoint tPoints[4];
-        fCTM.top().mapPoints(tPoints, points, 4);
+        getCTM().mapPoints(tPoints, points, 4);
 
         //if rotated, draw polygon
         if(tPoints[0].y() != tPoints[1].y()){
@@ -74,62 +114,30 @@ public:
             top = (int)std::max(0.f, tPoints[0].y());
             right = (int)std::min((float)width, tPoints[2].x());
             bottom = (int)std::min((float)height, tPoints[2].y());
-
-            if(shader != nullptr){ //if shader, shade row
-                //check is opaque
-                shader->setContext(fCTM.top());
-                GPixel* row = new GPixel[right-left];
-                if(shader->isOpaque())
-                {
-                    ptr = opaqueColor[static_cast<int>(source.getBlendMode())];
-                    if(ptr == kDst)
-                            return;
-
-                    for(int y = top; y < bottom; ++y){
-                        shader->shadeRow(left, y, right-left, row);
-                            for(int x = left; x < right; ++x){
-                                GPixel* dst = fDevice.getAddr(x, y);
-                                *dst = ptr(row[x-left], *dst);
-                            }
-                    }
-                    return;
-                }
-                for(int y = top; y < bottom; ++y){
-                    shader->shadeRow(left, y, right-left, row);
-                    for(int x = left; x < right; ++x){
-                        ptr = changeBlend(row[x-left], source.getBlendMode());
-                        if(ptr == kDst)
-                            continue;
-                        GPixel* dst = fDevice.getAddr(x, y);
-                        *dst = ptr(row[x-left], *dst);
-                    }
-                }
-                delete[] row;
-                return;
-            }
-            // else, blit rect
-            ptr = changeBlend(srcPixel, source.getBlendMode());
-            if(ptr == kDst)
-                return;
-            blit(&srcPixel, fDevice, top, bottom, left, right, ptr);
+            fillDeviceRect(left, top, right, bottom, source);
         }
     }
 
     void drawConvexPolygon(const GPoint points[], int count, const GPaint& source) override{
         if(count < 3) return;
-        std::vector<edge*> edges;
-        edges.reserve(count);
+        std::vector<edge> edgeList;
+        edgeList.reserve(count);
         GRect bounds = {0, 0, fDevice.width(), fDevice.height()};
-        GPoint tPoints[count];
-        GMatrix topMatrix = fCTM.top();
-        topMatrix.mapPoints(tPoints, points, count);
+        //map into the scratch buffer (drawPath() gathers its points there, so those map in place)
+        if(points != fPathPoints.data())
+            fPathPoints.resize(count);
+        getCTM().mapPoints(fPathPoints.data(), points, count);
+        const GPoint* tPoints = fPathPoints.data();
         
         //clipping creates edges, call clipper for each pair of points
         for(int i = 0; i < count-1; ++i){
-            clip(tPoints[i], tPoints[i+1], bounds, edges);
+            clip(tPoints[i], tPoints[i+1], bounds, edgeList);
         }
-        clip(tPoints[count-1], tPoints[0], bounds, edges);
-        if(edges.size() < 2) return;
+        clip(tPoints[count-1], tPoints[0], bounds, edgeList);
+        if(edgeList.size() < 2) return;
+        std::vector<edge*> edges;
+        for(edge& e : edgeList)
+            edges.push_back(&e);
 
         //sort edges
         std::sort(edges.begin(), edges.end(), edge_sorter);
@@ -168,7 +176,13 @@ public:
             }
         }
         else{
-            shader->setContext(topMatrix);
+            float minX = tPoints[0].x(), maxX = tPoints[0].x();
+            for(int i = 1; i < count; ++i){
+                minX = std::min(minX, tPoints[i].x());
+                maxX = std::max(maxX, tPoints[i].x());
+            }
+            if(!beginShade(source, GFloorToInt(minX), GCeilToInt(maxX), edges[0]->top))
+                return;
             for(int y = edges[0]->top; y < edges.back()->bottom; ++y){
                 x0 = edges[0]->curX;
                 x1 = edges[1]->curX;
@@ -178,28 +192,7 @@ public:
                 if(L > R)
                     std::swap(L, R);
 
-                GPixel* row = new GPixel[R-L];
-                shader->shadeRow(L, y, R-L, row);
-                if(shader->isOpaque())
-                {
-                    ptr = opaqueColor[static_cast<int>(source.getBlendMode())];
-                    if(ptr == kDst)
-                            return;
-                    for(int x = L; x < R; ++x){
-                        GPixel* dst = fDevice.getAddr(x, y);
-                        *dst = ptr(row[x-L], *dst);
-                    }   
-                }
-                else{
-                    for(int x = L; x < R; ++x){
-                        ptr = changeBlend(row[x-L], source.getBlendMode());
-                        if(ptr == kDst)
-                            continue;
-                        GPixel* dst = fDevice.getAddr(x, y);
-                        *dst = ptr(row[x-L], *dst);
-                    }
-                }
-                delete[] row;
+                shadeSpan(y, L, R);
 
                 edges[0]->curX += edges[0]->m;
                 edges[1]->curX += edges[1]->m;
@@ -215,459 +208,713 @@ public:
 
     void drawPath(const GPath& path, const GPaint& source) override{
         if(path.countPoints() < 3) return;
-        std::vector<edge*> edges;
-        edges.reserve(path.countPoints());
-        GRect bounds = {0, 0, fDevice.width(), fDevice.height()};
-        GPath tPath = path;
-        GMatrix topMatrix = fCTM.top();
-        tPath.transform(topMatrix);
-        
-
-        GPath::Edger edger = {tPath};
-        GPath::Verb edgerVerb;
-        GPoint edgerPts[4];
-
-        //clipping creates edges, call clipper for each pair of points
-        while ((edgerVerb = edger.next(edgerPts)) != GPath::kDone) {
-            if (edgerVerb == GPath::kLine || edgerVerb == GPath::kMove) {
-                clip(edgerPts[0], edgerPts[1], bounds, edges);
-            }
-            if(edgerVerb == GPath::kQuad){
-                //tolerance = .25
-                //math found in docs
-                GPoint A = edgerPts[0];
-                GPoint B = edgerPts[1];
-                GPoint C = edgerPts[2];
-                GPoint D = (A - 2*B + C)*.25f;
-                int k = GCeilToInt(sqrtf(D.length() * 4.f));
-                float divisions = (float)1/k;
-                float t = divisions;
-                GPoint p0 = A;
-                GPoint p1;
-                for(int i = 0; i < k-1; ++i){
-                    p1.fX = A.x() * (1-t)*(1-t) + 2*B.x()*t*(1-t) + C.x()*t*t;
-                    p1.fY = A.y() * (1-t)*(1-t) + 2*B.y()*t*(1-t) + C.y()*t*t;
-                    clip(p0, p1, bounds, edges);
-                    p0 = p1;
-                    t += divisions;
-                }
-                clip(p0, C, bounds, edges);
-            }
-            if(edgerVerb == GPath::kCubic){
-                GPoint A = edgerPts[0];
-                GPoint B = edgerPts[1];
-                GPoint C = edgerPts[2];
-                GPoint D = edgerPts[3];
-                GPoint E0 = A + 2*B + C;
-                GPoint E1 = B + 2*C + D;
-                GPoint E;
-                E.fX = std::max(fabs(E0.x()), fabs(E1.x()));
-                E.fY = std::max(fabs(E0.y()), fabs(E1.y()));
-                int k = GCeilToInt(sqrtf(E.length()*3.f*.25f * 4.f));
-                float divisions = (float)1/k;
-                float t = divisions;
-                GPoint p0 = A;
-                GPoint p1;
-                for(int i = 0; i < k-1; ++i){
-                    p1.fX = A.x() * (1-t)*(1-t)*(1-t) + 3*B.x()*t*(1-t)*(1-t) + 3*C.x()*t*t*(1-t) + D.x()*t*t*t;
-                    p1.fY = A.y() * (1-t)*(1-t)*(1-t) + 3*B.y()*t*(1-t)*(1-t) + 3*C.y()*t*t*(1-t) + D.y()*t*t*t;
-                    clip(p0, p1, bounds, edges);
-                    p0 = p1;
-                    t += divisions;
-                }
-                clip(p0, D, bounds, edges);
-            }
+        const GMatrix& topMatrix = getCTM();
+
+        //simple shapes go to the cheaper scanners
+        GPath::Shape shape = path.shape();
+        if(shape == GPath::kRect_Shape && !(topMatrix.getType() & GMatrix::kAffine_Mask)){
+            GRect r = path.bounds();
+            GPoint corners[2] = {{r.left(), r.top()}, {r.right(), r.bottom()}};
+            topMatrix.mapPoints(corners, 2);
+            //the same rounding as the edges of the rect would get
+            int left = std::max(GRoundToInt(std::min(corners[0].x(), corners[1].x())), 0);
+            int right = std::min(GRoundToInt(std::max(corners[0].x(), corners[1].x())), fDevice.width());
+            int top = std::max(GRoundToInt(std::min(corners[0].y(), corners[1].y())), 0);
+            int bottom = std::min(GRoundToInt(std::max(corners[0].y(), corners[1].y())), fDevice.height());
+            if(left < right && top < bottom)
+                fillDeviceRect(left, top, right, bottom, source);
+            return;
         }
-        if(edges.size() < 2) return;
-        //sort edges
-        std::sort(edges.begin(), edges.end(), edge_sorter);
+        if(shape == GPath::kRect_Shape || shape == GPath::kConvex_Shape){
+            fPathPoints.clear();
+            GPath::Iter iter(path);
+            GPoint pts[GPath::kMaxNextPoints];
+            GPath::Verb verb;
+            while((verb = iter.next(pts)) != GPath::kDone)
+                fPathPoints.push_back(verb == GPath::kMove ? pts[0] : pts[1]);
+            drawConvexPolygon(fPathPoints.data(), (int)fPathPoints.size(), source);
+            return;
+        }
+
+        GRect pathBounds;
+        const std::vector<edge>* edges;
+        float dx;
+        int dy;
+        if(!buildPathEdges(path, topMatrix, &pathBounds, &edges, &dx, &dy)) return;
 
         GShader *shader = source.getShader();
-        BlendProc ptr;
-        int y = edges[0]->top;
-        int accum, i, L, R;
         if(shader == nullptr){
             GPixel srcPixel = makePixel(source.getColor());
-            ptr = changeBlend(srcPixel, source.getBlendMode());
-            if(ptr == kDst){
+            BlendProc ptr = changeBlend(srcPixel, source.getBlendMode());
+            if(ptr == kDst)
+                return;
+            scanPathEdges(*edges, dx, dy, [&](int y, int L, int R){
+                blit(&srcPixel, fDevice, y, y+1, L, R, ptr);
+            });
+        }
+        else{
+            if(!beginShade(source, GFloorToInt(pathBounds.left()), GCeilToInt(pathBounds.right()), (*edges)[0].top + dy))
                 return;
+            scanPathEdges(*edges, dx, dy, [&](int y, int L, int R){
+                shadeSpan(y, L, R);
+            });
+        }
+    }
+
+    void drawHairlines(const GPoint pts[], int count, const GPaint& source) override{
+        if(count < 2) return;
+        fPathPoints.resize(count);
+        getCTM().mapPoints(fPathPoints.data(), pts, count);
+        GIRect clipBounds = GIRect::LTRB(0, 0, fDevice.width(), fDevice.height());
+
+        if(source.getShader() != nullptr){
+            GPoint minPt = fPathPoints[0], maxPt = fPathPoints[0];
+            for(const GPoint& pt : fPathPoints){
+                minPt = {std::min(minPt.x(), pt.x()), std::min(minPt.y(), pt.y())};
+                maxPt = {std::max(maxPt.x(), pt.x()), std::max(maxPt.y(), pt.y())};
             }
-            while(y < bounds.bottom()){
-                accum = 0;
-                i = 0;
-        
-                while(i < edges.size() && edges[i]->active(y)){
-                    float x = edges[i]->curX;
-
-                    if (accum == 0) L = GRoundToInt(x);
-                    accum += edges[i]->winding;
-                    if(accum == 0)  blit(&srcPixel, fDevice, y, y+1, L, GRoundToInt(x), ptr);
-
-                    edges[i]->curX += edges[i]->m;
-                    if(edges[i]->lastY(y)){
-                        edges.erase(edges.begin()+i);
-                        if(edges.size() == 0) return;
-                    }
-                    else ++i;
-                }
+            //a line at a whole x still covers the column at floor(x), so the right edge is past it
+            if(!beginShade(source, GFloorToInt(minPt.x()), GFloorToInt(maxPt.x()) + 1, std::max(GFloorToInt(minPt.y()), 0)))
+                return;
+            scanHairlines(fPathPoints.data(), count, clipBounds, [&](int L, int T, int R, int B){
+                for(int y = T; y < B; ++y)
+                    shadeSpan(y, L, R);
+            });
+            return;
+        }
 
-                assert(accum == 0);
-                ++y;
+        GPixel srcPixel = makePixel(source.getColor());
+        BlendProc ptr = changeBlend(srcPixel, source.getBlendMode());
+        if(ptr == kDst)
+            return;
+        scanHairlines(fPathPoints.data(), count, clipBounds, [&](int L, int T, int R, int B){
+            blit(&srcPixel, fDevice, T, B, L, R, ptr);
+        });
+    }
 
-                while(i < edges.size() && edges[i]->active(y))
-                    ++i;
+    void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count, const int indices[], const GPaint& source) override{
+        GShader* shader = texs != nullptr ? source.getShader() : nullptr;
+        if((colors == nullptr && shader == nullptr) || count <= 0)
+            return;
 
-                //resort in x
-                std::sort(edges.begin(), edges.begin()+i, &edge_sorter2);
+        //vertices are shared between triangles, so map each one to device space only once
+        int vertexCount = *std::max_element(indices, indices + count*3) + 1;
+        fMeshPoints.resize(vertexCount);
+        getCTM().mapPoints(fMeshPoints.data(), verts, vertexCount);
+
+        MeshState state;
+        state.colors = colors;
+        state.texs = texs;
+        state.indices = indices;
+        state.shader = shader;
+        state.mode = source.getBlendMode();
+        state.alpha = GRoundToInt(GPinToUnit(source.getAlpha()) * 255);
+
+        //shaders keep one context, so only color-only meshes can be split across threads
+        int threads = shader == nullptr && count >= kParallelMeshMin ? meshThreadCount() : 1;
+        int batch = threads > 1 ? kParallelMeshBatch : kMeshBatch;
+        GIRect clipBounds = GIRect::LTRB(0, 0, fDevice.width(), fDevice.height());
+
+        for(int first = 0; first < count; first += batch){
+            //set up the whole batch first, then scan it, so each pass stays in cache
+            setupMeshTriangles(state, first, std::min(first + batch, count));
+            if(threads > 1){
+                scanMeshParallel(state, threads);
+                continue;
             }
+            for(const MeshTriangle& tri : fMeshTriangles)
+                scanMeshTriangle(state, tri, clipBounds, fRow.data(), fColorRow.data());
         }
-        else{
-            shader->setContext(topMatrix);
-            while(y < bounds.bottom()){
-                accum = 0;
-                i = 0;
-        
-                while(i < edges.size() && edges[i]->active(y)){
-                    float x = edges[i]->curX;
-                    if (accum == 0) L = GRoundToInt(x);
-
-                    accum += edges[i]->winding;
-                    if(accum == 0){
-                        R = GRoundToInt(x);
-                        GPixel* row = new GPixel[R-L];
-                        shader->shadeRow(L, y, R-L, row);
-                        if(shader->isOpaque())
-                        {
-                            ptr = opaqueColor[static_cast<int>(source.getBlendMode())];
-                            if(ptr == kDst)
-                                    return;
-                            for(int x = L; x < R; ++x){
-                                GPixel* dst = fDevice.getAddr(x, y);
-                                *dst = ptr(row[x-L], *dst);
-                            }  
-                        }
-                        else{
-                            for(int x = L; x < R; ++x){
-                                ptr = changeBlend(row[x-L], source.getBlendMode());
-                                if(ptr == kDst)
-                                    continue;
-                                GPixel* dst = fDevice.getAddr(x, y);
-                                *dst = ptr(row[x-L], *dst);
-                            }
-                        }
-                        delete[] row;
-                    }
-
-                    edges[i]->curX += edges[i]->m;
-                    if(edges[i]->lastY(y)){
-                        edges.erase(edges.begin()+i);
-                        if(edges.size() == 0) return;
-                    }
-                    else ++i;
-                }
+    }
+
+    void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level, const GPaint& source) override{
+        if(level < 0 || (colors == nullptr && texs == nullptr))
+            return;
 
-                assert(accum == 0);
-                ++y;
+        //one shared grid of vertices, in scratch buffers reused across calls, drawn as a single mesh
+        int divisions = level + 2;
+        int vertexCount = divisions * divisions;
+        float step = 1.0f/(divisions - 1);
+        fQuadPoints.resize(vertexCount);
+        if(colors != nullptr)
+            fQuadColors.resize(vertexCount);
+        if(texs != nullptr)
+            fQuadTexs.resize(vertexCount);
+
+        for(int i = 0; i < divisions; ++i){
+            float v = i == divisions - 1 ? 1 : i * step;
+            for(int j = 0; j < divisions; ++j){
+                float u = j == divisions - 1 ? 1 : j * step;
+                int k = i * divisions + j;
+                fQuadPoints[k] = quadLerp(verts, u, v);
+                if(colors != nullptr)
+                    fQuadColors[k] = quadLerp(colors, u, v);
+                if(texs != nullptr)
+                    fQuadTexs[k] = quadLerp(texs, u, v);
+            }
+        }
 
-                while(i < edges.size() && edges[i]->active(y))
-                    ++i;
+        fQuadIndices.resize((divisions - 1) * (divisions - 1) * 6);
+        gridIndices(divisions, fQuadIndices.data());
 
-                //resort in x
-                std::sort(edges.begin(), edges.begin()+i, &edge_sorter2);
+        drawMesh(fQuadPoints.data(), colors != nullptr ? fQuadColors.data() : nullptr, texs != nullptr ? fQuadTexs.data() : nullptr, 
+                 (divisions - 1) * (divisions - 1) * 2, fQuadIndices.data(), source);
+    }
+
+    void drawTexturedMesh(const GPoint verts[], const float ws[], const GPoint texs[], int count, const int indices[], 
+                          const GBitmap& texture, FilterMode filter, const GPaint& source) override{
+        if(count <= 0 || texture.width() <= 0 || texture.height() <= 0 || !texture.pixels())
+            return;
+
+        int vertexCount = *std::max_element(indices, indices + count*3) + 1;
+        fMeshPoints.resize(vertexCount);
+        getCTM().mapPoints(fMeshPoints.data(), verts, vertexCount);
+
+        GIRect clipBounds = GIRect::LTRB(0, 0, fDevice.width(), fDevice.height());
+        unsigned alpha = GRoundToInt(GPinToUnit(source.getAlpha()) * 255);
+        BlendRowProc rowProc = blendRowProc(source.getBlendMode(), texture.isOpaque());
+        TextureRowProc sampleRow = textureRowProc(filter == kBilinear, ws != nullptr);
+
+        for(int i = 0; i < count*3; i+=3){
+            const int i0 = indices[i], i1 = indices[i+1], i2 = indices[i+2];
+            GPoint pts[3] = {fMeshPoints[i0], fMeshPoints[i1], fMeshPoints[i2]};
+            GMatrix basis = GMatrix(pts[2].x() - pts[0].x(), pts[1].x() - pts[0].x(), pts[0].x(), 
+                                    pts[2].y() - pts[0].y(), pts[1].y() - pts[0].y(), pts[0].y());
+            GMatrix inverse;
+            if(!basis.invert(&inverse)) //no area
+                continue;
+
+            //with perspective, tex/w and 1/w are linear in device space (tex itself is not)
+            float q[3] = {1, 1, 1};
+            if(ws != nullptr){
+                q[0] = 1 / ws[i0];
+                q[1] = 1 / ws[i1];
+                q[2] = 1 / ws[i2];
             }
+            GPoint uv[3] = {texs[i0] * q[0], texs[i1] * q[1], texs[i2] * q[2]};
+            GPoint uvDX, uvDY, uvOrigin;
+            float qDX, qDY, qOrigin;
+            vertexGradient(uv, inverse, &uvDX, &uvDY, &uvOrigin);
+            vertexGradient(q, inverse, &qDX, &qDY, &qOrigin);
+
+            scanTriangle(pts, clipBounds, [&](int y, int L, int R){
+                float x = L + .5f;
+                GPoint start = uvOrigin + uvDX * x + uvDY * (y + .5f);
+                sampleRow(texture, start, uvDX, qOrigin + qDX * x + qDY * (y + .5f), qDX, R-L, fRow.data());
+                rowProc(fDevice.getAddr(L, y), fRow.data(), R-L, alpha);
+            });
         }
+    }
 
+private:
+    // drawMesh() scratch: the mesh's vertices in device space, and the setup for the batch of
+    // triangles being drawn.
+    struct MeshTriangle{
+        GPoint pts[3];
+        GColor colorDX, colorDY, colorOrigin;
+        GMatrix shaderMatrix;
+        bool opaque;
+    };
+
+    // The parts of a drawMesh() call that every triangle needs.
+    struct MeshState{
+        const GColor* colors;
+        const GPoint* texs;
+        const int* indices;
+        GShader* shader;
+        GBlendMode mode;
+        unsigned alpha;
+    };
+
+    static const int kMeshBatch = 256;
+    static const int kParallelMeshBatch = 1 << 16;
+    static const int kParallelMeshMin = 4096;
+    static const int kMeshBandHeight = 32;
+
+    static int meshThreadCount(){
+        return std::max(1, std::min((int)std::thread::hardware_concurrency(), 16));
     }
 
-    void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count, const int indices[], const GPaint& source) override{
-        std::vector<edge*> edges;
-        edges.reserve(count);
-        GRect bounds = {0, 0, fDevice.width(), fDevice.height()};
-        GPoint tPoints[count*3];
-        GMatrix topMatrix = fCTM.top();
-        topMatrix.mapPoints(tPoints, verts, count*3);
-
-        if(texs != nullptr && colors != nullptr){
-            for(int i = 0; i < count*3; i+=3){
-                GMatrix coordMatrix = GMatrix(verts[indices[i+2]].x() - verts[indices[i]].x(), verts[indices[i+1]].x() - verts[indices[i]].x(), verts[indices[i]].x(), 
-                                              verts[indices[i+2]].y() - verts[indices[i]].y(), verts[indices[i+1]].y() - verts[indices[i]].y(), verts[indices[i]].y());
-                GMatrix textureMatrix = GMatrix(texs[indices[i+2]].x() - texs[indices[i]].x(), texs[indices[i+1]].x() - texs[indices[i]].x(), texs[indices[i]].x(), 
-                                                texs[indices[i+2]].y() - texs[indices[i]].y(), texs[indices[i+1]].y() - texs[indices[i]].y(), texs[indices[i]].y());
+    /**
+     *  Fill fMeshTriangles with the setup for triangles [first, last), in order, skipping any
+     *  with no area in device or texture space. fMeshPoints must already hold the mapped vertices.
+     */
+    void setupMeshTriangles(const MeshState& state, int first, int last){
+        const int* indices = state.indices;
+        const GPoint* texs = state.texs;
+        bool shaderOpaque = state.shader == nullptr || state.shader->isOpaque();
+
+        fMeshTriangles.clear();
+        for(int i = first*3; i < last*3; i+=3){
+            const int i0 = indices[i], i1 = indices[i+1], i2 = indices[i+2];
+            MeshTriangle tri;
+            tri.pts[0] = fMeshPoints[i0];
+            tri.pts[1] = fMeshPoints[i1];
+            tri.pts[2] = fMeshPoints[i2];
+
+            GMatrix basis = GMatrix(tri.pts[2].x() - tri.pts[0].x(), tri.pts[1].x() - tri.pts[0].x(), tri.pts[0].x(), 
+                                    tri.pts[2].y() - tri.pts[0].y(), tri.pts[1].y() - tri.pts[0].y(), tri.pts[0].y());
+            GMatrix inverse;
+            if(!basis.invert(&inverse)) //no area
+                continue;
+
+            tri.opaque = shaderOpaque;
+            if(state.colors != nullptr){
+                GColor triColors[3] = {state.colors[i0], state.colors[i1], state.colors[i2]};
+                vertexGradient(triColors, inverse, &tri.colorDX, &tri.colorDY, &tri.colorOrigin);
+                tri.opaque = tri.opaque && triColors[0].a >= 1 && triColors[1].a >= 1 && triColors[2].a >= 1;
+            }
+
+            if(state.shader != nullptr){
+                GMatrix textureMatrix = GMatrix(texs[i2].x() - texs[i0].x(), texs[i1].x() - texs[i0].x(), texs[i0].x(), 
+                                                texs[i2].y() - texs[i0].y(), texs[i1].y() - texs[i0].y(), texs[i0].y());
                 GMatrix textureInverse;
-                textureMatrix.invert(&textureInverse);
+                if(!textureMatrix.invert(&textureInverse))
+                    continue;
+                //the device basis already includes the CTM, so texture space maps straight to device space
+                tri.shaderMatrix = basis * textureInverse;
+            }
+            fMeshTriangles.push_back(tri);
+        }
+    }
 
-                ProxyShader textShader(source.getShader(), coordMatrix * textureInverse);
-                textShader.setContext(topMatrix);
+    /**
+     *  Shade and blend the part of tri inside clip. row and colorRow are scratch rows at least as
+     *  wide as clip; the caller owns them so threads never share one.
+     */
+    void scanMeshTriangle(const MeshState& state, const MeshTriangle& tri, const GIRect& clip, GPixel row[], GPixel colorRow[]){
+        GShader* shader = state.shader;
+        if(shader != nullptr && !shader->setContext(tri.shaderMatrix))
+            return;
 
-                GColor newColors[3] = {colors[indices[i]], colors[indices[i+1]], colors[indices[i+2]]};
-                GPoint newPoints[3] = {tPoints[indices[i]], tPoints[indices[i+1]], tPoints[indices[i+2]]};
-                
-                GMatrix colorMatrix = GMatrix(newPoints[2].x() - newPoints[0].x(), newPoints[1].x() - newPoints[0].x(), newPoints[0].x(), 
-                                              newPoints[2].y() - newPoints[0].y(), newPoints[1].y() - newPoints[0].y(), newPoints[0].y());
-                
-                GMatrix colorInvert;
-                colorMatrix.invert(&colorInvert);
-
-                clip(newPoints[0], newPoints[1], bounds, edges);
-                clip(newPoints[1], newPoints[2], bounds, edges);
-                clip(newPoints[2], newPoints[0], bounds, edges);
-                if(edges.size() < 2) return;
-
-                //sort edges
-                std::sort(edges.begin(), edges.end(), edge_sorter);
-
-                int L, R;
-                float x0, x1;
-
-                for(int y = edges[0]->top; y < edges.back()->bottom; ++y){
-                    x0 = edges[0]->curX;
-                    x1 = edges[1]->curX;
-                    L = GRoundToInt(x0);
-                    R = GRoundToInt(x1);
-
-                    if(L > R)
-                        std::swap(L, R);
-
-                    GPixel* row = new GPixel[R-L];
-                    textShader.shadeRow(L, y, R-L, row);
-                    for(int x = L; x < R; ++x){
-                        GColor color;
-                        GPoint point = colorInvert * GPoint{x+.5f, y+.5f};
-
-                        color = newColors[2] * point.x() + newColors[1] * point.y() + newColors[0] * (1-point.x()-point.y());
-
-                        GPixel colorPixel = makePixel(color);
-                        GPixel textPixel = row[x-L];
-
-                        int a = div255(GPixel_GetA(colorPixel) * GPixel_GetA(textPixel));
-                        int r = div255(GPixel_GetR(colorPixel) * GPixel_GetR(textPixel));
-                        int g = div255(GPixel_GetG(colorPixel) * GPixel_GetG(textPixel));
-                        int b = div255(GPixel_GetB(colorPixel) * GPixel_GetB(textPixel));
-
-                        GPixel *dst = fDevice.getAddr(x, y);
-                        *dst = GPixel_PackARGB(a, r, g, b);
-                    }
-                    delete[] row;
-
-                    edges[0]->curX += edges[0]->m;
-                    edges[1]->curX += edges[1]->m;
-                    if(edges[1]->lastY(y))
-                        edges.erase(edges.begin()+1);
-                    if(edges[0]->lastY(y))
-                        edges.erase(edges.begin());
-                    
-                    if(edges.size() == 0) break;
+        BlendRowProc rowProc = blendRowProc(state.mode, tri.opaque);
+        scanTriangle(tri.pts, clip, [&](int y, int L, int R){
+            if(shader != nullptr)
+                shader->shadeRow(L, y, R-L, row);
+            if(state.colors != nullptr){
+                GColor start = tri.colorOrigin + (L + .5f) * tri.colorDX + (y + .5f) * tri.colorDY;
+                GPixel* colors = shader != nullptr ? colorRow : row;
+                interpolateColorRow(colors, R-L, start, tri.colorDX);
+                if(shader != nullptr){
+                    for(int x = 0; x < R-L; ++x)
+                        row[x] = multiplyPixel(colorRow[x], row[x]);
                 }
             }
+            rowProc(fDevice.getAddr(L, y), row, R-L, state.alpha);
+        });
+    }
+
+    /**
+     *  Scan fMeshTriangles on several threads. The device is cut into bands of rows and each
+     *  triangle is binned into every band it touches, in submission order. A band is drawn by one
+     *  thread from start to finish, so overlapping triangles blend in the same order as the
+     *  serial path and the result does not depend on scheduling.
+     */
+    void scanMeshParallel(const MeshState& state, int threads){
+        int width = fDevice.width();
+        int height = fDevice.height();
+        int bandCount = (height + kMeshBandHeight - 1) / kMeshBandHeight;
+        if(bandCount <= 0)
             return;
+
+        std::vector<std::vector<int>> bins(bandCount);
+        for(int i = 0; i < (int)fMeshTriangles.size(); ++i){
+            const GPoint* pts = fMeshTriangles[i].pts;
+            int top = std::max(GRoundToInt(std::min(pts[0].y(), std::min(pts[1].y(), pts[2].y()))), 0);
+            int bottom = std::min(GRoundToInt(std::max(pts[0].y(), std::max(pts[1].y(), pts[2].y()))), height);
+            for(int band = top / kMeshBandHeight; top < bottom && band * kMeshBandHeight < bottom; ++band)
+                bins[band].push_back(i);
         }
-        if(texs != nullptr){
-            GMatrix coordMatrix = GMatrix(verts[2].x() - verts[0].x(), verts[1].x() - verts[0].x(), verts[0].x(), 
-                                          verts[2].y() - verts[0].y(), verts[1].y() - verts[0].y(), verts[0].y());
-            
-            GMatrix textureMatrix = GMatrix(texs[2].x() - texs[0].x(), texs[1].x() - texs[0].x(), texs[0].x(), 
-                                            texs[2].y() - texs[0].y(), texs[1].y() - texs[0].y(), texs[0].y());
-            GMatrix textureInverse;
-            textureMatrix.invert(&textureInverse);
 
-            ProxyShader textShader(source.getShader(), coordMatrix * textureInverse);
-            textShader.setContext(topMatrix);
-                
-            clip(tPoints[0], tPoints[1], bounds, edges);
-            clip(tPoints[1], tPoints[2], bounds, edges);
-            clip(tPoints[2], tPoints[0], bounds, edges);
-            if(edges.size() < 2) return;
+        std::atomic<int> nextBand(0);
+        auto worker = [&](){
+            std::vector<GPixel> row(width), colorRow(width);
+            for(int band = nextBand++; band < bandCount; band = nextBand++){
+                GIRect clip = GIRect::LTRB(0, band * kMeshBandHeight, width, std::min((band + 1) * kMeshBandHeight, height));
+                for(int i : bins[band])
+                    scanMeshTriangle(state, fMeshTriangles[i], clip, row.data(), colorRow.data());
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for(int i = 1; i < std::min(threads, bandCount); ++i)
+            pool.emplace_back(worker);
+        worker();
+        for(std::thread& thread : pool)
+            thread.join();
+    }
 
-            //sort edges
-            std::sort(edges.begin(), edges.end(), edge_sorter);
+    /**
+     *  Return a buffer of count transparent pixels, reusing the pooled buffer that best fits
+     *  rather than allocating a new one for every layer.
+     */
+    std::vector<GPixel> takeLayerPixels(int count){
+        std::vector<GPixel> pixels;
+        auto best = fLayerPool.end();
+        for(auto it = fLayerPool.begin(); it != fLayerPool.end(); ++it){
+            if(best == fLayerPool.end()){
+                best = it;
+                continue;
+            }
+            //the smallest that fits, else the largest (the least to grow)
+            bool fits = it->capacity() >= (size_t)count;
+            bool bestFits = best->capacity() >= (size_t)count;
+            if(fits ? !bestFits || it->capacity() < best->capacity() : !bestFits && it->capacity() > best->capacity())
+                best = it;
+        }
+        if(best != fLayerPool.end()){
+            pixels = std::move(*best);
+            fLayerPool.erase(best);
+        }
+        pixels.assign(count, 0);
+        return pixels;
+    }
 
-            int L, R;
-            float x0, x1;
+    // Blend the top layer onto the device under it, and pool its pixels.
+    void restoreLayer(){
+        Layer& layer = fLayers.back();
+        GBitmap bitmap = fDevice;
+        fDevice = layer.parent;
+        if(!layer.empty && layer.mode != GBlendMode::kDst){
+            BlendRowProc rowProc = blendRowProc(layer.mode, false);
+            for(int y = 0; y < bitmap.height(); ++y)
+                rowProc(fDevice.getAddr(layer.left, layer.top + y), bitmap.getAddr(0, y), bitmap.width(), layer.alpha);
+        }
 
-            for(int y = edges[0]->top; y < edges.back()->bottom; ++y){
-                x0 = edges[0]->curX;
-                x1 = edges[1]->curX;
-                L = GRoundToInt(x0);
-                R = GRoundToInt(x1);
+        fLayerPool.push_back(std::move(layer.pixels));
+        if((int)fLayerPool.size() > kLayerPoolSize){ //drop the smallest
+            auto smallest = std::min_element(fLayerPool.begin(), fLayerPool.end(), [](const std::vector<GPixel>& a, const std::vector<GPixel>& b){
+                return a.capacity() < b.capacity();
+            });
+            fLayerPool.erase(smallest);
+        }
+        fLayers.pop_back();
+    }
 
-                if(L > R)
-                    std::swap(L, R);
+    // Fill device rows [top, bottom) between columns [left, right), which must be on the device.
+    void fillDeviceRect(int left, int top, int right, int bottom, const GPaint& source){
+        GShader* shader = source.getShader();
+        if(shader != nullptr){ //if shader, shade row
+            if(!beginShade(source, left, right, top))
+                return;
+            for(int y = top; y < bottom; ++y)
+                shadeSpan(y, left, right);
+            return;
+        }
+        // else, blit rect
+        GPixel srcPixel = makePixel(source.getColor());
+        BlendProc ptr = changeBlend(srcPixel, source.getBlendMode());
+        if(ptr == kDst)
+            return;
+        blit(&srcPixel, fDevice, top, bottom, left, right, ptr);
+    }
 
-                GPixel* row = new GPixel[R-L];
-                textShader.shadeRow(L, y, R-L, row);
-                for(int x = L; x < R; ++x){
-                    GPixel* dst = fDevice.getAddr(x, y);
-                    *dst = row[x-L];
-                }
-                delete[] row;
+    /**
+     *  Set *edges to the path's edges under ctm, clipped to the device and sorted by top then x,
+     *  to be drawn offset by (dx, dy), and set bounds to the path's device-space bounds. Returns
+     *  false if there is nothing to draw.
+     *
+     *  The edges of paths that need no clipping (and aren't huge) are cached by generation ID and
+     *  matrix, and handed out in place. If the matrix only adds a translation that is whole
+     *  pixels in y (so rows round the same way), the cached edges are reused with that offset, as
+     *  long as they still need no clipping.
+     */
+    bool buildPathEdges(const GPath& path, const GMatrix& ctm, GRect* bounds, const std::vector<edge>** edges, float* dx, int* dy){
+        uint32_t id = path.genID();
+        float width = fDevice.width();
+        float height = fDevice.height();
+        auto unclipped = [&](const GRect& r){
+            return r.left() >= 0 && r.top() >= 0 && r.right() <= width && r.bottom() <= height;
+        };
+
+        ++fPathCacheClock;
+        for(PathCacheEntry& entry : fPathCache){
+            const GMatrix& m = entry.matrix;
+            if(entry.genID != id || m[0] != ctm[0] || m[1] != ctm[1] || m[3] != ctm[3] || m[4] != ctm[4])
+                continue;
+            float moveX = ctm[2] - m[2];
+            float moveY = ctm[5] - m[5];
+            GRect moved = GRect::LTRB(entry.bounds.left() + moveX, entry.bounds.top() + moveY, entry.bounds.right() + moveX, entry.bounds.bottom() + moveY);
+            if(moveY != floorf(moveY) || !unclipped(moved))
+                continue;
+
+            entry.lastUse = fPathCacheClock;
+            *edges = &entry.edges;
+            *dx = moveX;
+            *dy = (int)moveY;
+            *bounds = moved;
+            return entry.edges.size() >= 2;
+        }
 
-                edges[0]->curX += edges[0]->m;
-                edges[1]->curX += edges[1]->m;
-                if(edges[1]->lastY(y))
-                    edges.erase(edges.begin()+1);
-                if(edges[0]->lastY(y))
-                    edges.erase(edges.begin());
-                
-                if(edges.size() == 0) break;
+        //the points are mapped into a scratch buffer that is reused across draws, rather than
+        //mapping a copy of the path, and the edger walks the path's verbs over them
+        int count = path.countPoints();
+        fPathPoints.resize(count);
+        ctm.mapPoints(fPathPoints.data(), path.points(), count);
+        GPoint minPt = fPathPoints[0], maxPt = fPathPoints[0];
+        for(const GPoint& pt : fPathPoints){
+            minPt = {std::min(minPt.x(), pt.x()), std::min(minPt.y(), pt.y())};
+            maxPt = {std::max(maxPt.x(), pt.x()), std::max(maxPt.y(), pt.y())};
+        }
+        *bounds = GRect::LTRB(minPt.x(), minPt.y(), maxPt.x(), maxPt.y());
+
+        GRect device = {0, 0, width, height};
+        fPathEdges.clear();
+        GPath::Edger edger = {path, fPathPoints.data()};
+        GPath::Verb edgerVerb;
+        GPoint edgerPts[4];
+
+        //clipping creates edges, call clipper for each pair of points
+        while ((edgerVerb = edger.next(edgerPts)) != GPath::kDone) {
+            if (edgerVerb == GPath::kLine || edgerVerb == GPath::kMove) {
+                clip(edgerPts[0], edgerPts[1], device, fPathEdges);
+            }
+            if(edgerVerb == GPath::kQuad){
+                clipQuad(edgerPts, device, fPathEdges);
+            }
+            if(edgerVerb == GPath::kCubic){
+                clipCubic(edgerPts, device, fPathEdges);
             }
-            return;
         }
-        if(colors != nullptr){
-            for(int i = 0; i < count*3; i+=3){
-                GColor newColors[3] = {colors[indices[i]], colors[indices[i+1]], colors[indices[i+2]]};
-                GPoint newPoints[3] = {tPoints[indices[i]], tPoints[indices[i+1]], tPoints[indices[i+2]]};
-                
-                GMatrix colorMatrix = GMatrix(newPoints[2].x() - newPoints[0].x(), newPoints[1].x() - newPoints[0].x(), newPoints[0].x(), 
-                                              newPoints[2].y() - newPoints[0].y(), newPoints[1].y() - newPoints[0].y(), newPoints[0].y());
-                
-                GMatrix colorInvert;
-                colorMatrix.invert(&colorInvert);
-                    
-                clip(newPoints[0], newPoints[1], bounds, edges);
-                clip(newPoints[1], newPoints[2], bounds, edges);
-                clip(newPoints[2], newPoints[0], bounds, edges);
-                if(edges.size() < 2) return;
-
-                //sort edges
-                std::sort(edges.begin(), edges.end(), edge_sorter);
-
-                int L, R;
-                float x0, x1;
-
-                for(int y = edges[0]->top; y < edges.back()->bottom; ++y){
-                    x0 = edges[0]->curX;
-                    x1 = edges[1]->curX;
-                    L = GRoundToInt(x0);
-                    R = GRoundToInt(x1);
-
-                    if(L > R)
-                        std::swap(L, R);
-
-                    for(int x = L; x < R; ++x){
-                        GPoint point = colorInvert * GPoint{x+.5f, y+.5f};
-
-                        GColor color = newColors[2] * point.x() + newColors[1] * point.y() + newColors[0] * (1-point.x()-point.y());
-
-                        GPixel* dst = fDevice.getAddr(x, y);
-                        *dst = makePixel(color);
-                    }
-
-                    edges[0]->curX += edges[0]->m;
-                    edges[1]->curX += edges[1]->m;
-                    if(edges[1]->lastY(y))
-                        edges.erase(edges.begin()+1);
-                    if(edges[0]->lastY(y))
-                        edges.erase(edges.begin());
-                    
-                    if(edges.size() == 0) break;
-                }
+        std::sort(fPathEdges.begin(), fPathEdges.end(), [](const edge& e1, const edge& e2){
+            if(e1.top == e2.top)
+                return e1.curX < e2.curX;
+            return e1.top < e2.top;
+        });
+
+        *edges = &fPathEdges;
+        *dx = 0;
+        *dy = 0;
+        if(unclipped(*bounds) && fPathEdges.size() <= kMaxCachedEdges){
+            //the edges move into the least recently used entry, which gives its buffer back
+            PathCacheEntry* entry = &fPathCache[0];
+            for(PathCacheEntry& e : fPathCache){
+                if(e.lastUse < entry->lastUse)
+                    entry = &e;
             }
-            return;
+            entry->genID = id;
+            entry->matrix = ctm;
+            entry->bounds = *bounds;
+            std::swap(entry->edges, fPathEdges);
+            entry->lastUse = fPathCacheClock;
+            *edges = &entry->edges;
         }
+        return (*edges)->size() >= 2;
     }
 
-    void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level, const GPaint& source) override{
-        int divisions = level + 2;
-        float step = 1.0f/(divisions - 1);
-        GPoint topLeft = verts[0];
-        GPoint topRight = verts[1];
-        GPoint bottomRight = verts[2];
-        GPoint bottomLeft = verts[3];
-
-        GPoint quad[divisions][divisions];
-        GPoint quadTex[divisions][divisions];
-        GColor quadColor[divisions][divisions];
-
-        if(colors != nullptr){
-            GColor color1 = colors[0];
-            GColor color2 = colors[1];
-
-            for(int i = 0; i < divisions; ++i){
-                for(int j = 0; j < divisions; ++j){
-                    GPoint point = topLeft + (topRight - topLeft) * j * step;
-                    GColor color = color1 + (color2 - color1) * j * step;
-                    quad[i][j] = point;
-                    quadColor[i][j] = color;
-                }
-                topLeft += (verts[3] - verts[0]) * step;
-                topRight += (verts[2] - verts[1]) * step;
-                color1 += (colors[3] - colors[0]) * step;
-                color2 += (colors[2] - colors[1]) * step;
+    /**
+     *  Fill the spans inside edges (sorted by top then x, offset by (dx, dy)) by nonzero winding,
+     *  calling span(y, L, R) for each span on the device. The edges are read in place: stepping
+     *  an edge changes it, so each one is copied into fActiveEdges only once the scan reaches its
+     *  top, and the offset is applied then.
+     */
+    template <typename Span> void scanPathEdges(const std::vector<edge>& edges, float dx, int dy, Span&& span){
+        //reserved up front, so the pointers into it stay put
+        fActiveEdges.clear();
+        fActiveEdges.reserve(edges.size());
+        fActive.clear();
+        size_t next = 0;
+        int y = edges[0].top + dy;
+        while(y < fDevice.height()){
+            //edges that start on this row join the active ones, which are kept sorted in x
+            bool joined = false;
+            while(next < edges.size() && edges[next].top + dy == y){
+                fActiveEdges.push_back(edges[next++]);
+                if(dx != 0 || dy != 0)
+                    fActiveEdges.back().offset(dx, dy);
+                fActive.push_back(&fActiveEdges.back());
+                joined = true;
+            }
+            if(joined)
+                std::sort(fActive.begin(), fActive.end(), &edge_sorter2);
+            if(fActive.empty()){
+                if(next == edges.size())
+                    return;
+                y = edges[next].top + dy;
+                continue;
             }
 
-            for(int i = 0; i < divisions-1; ++i){
-                for(int j = 0; j < divisions-1; ++j){
-                    GPoint topLeftTri = quad[i][j];
-                    GPoint topRightTri = quad[i][j+1];
-                    GPoint bottomLeftTri = quad[i+1][j];
-                    GPoint bottomRightTri = quad[i+1][j+1];
-
-                    GColor topLeftColor = quadColor[i][j];
-                    GColor topRightColor = quadColor[i][j+1];
-                    GColor bottomLeftColor = quadColor[i+1][j];
-                    GColor bottomRightColor = quadColor[i+1][j+1];
-
-                    GPoint triVerts[3] = {topLeftTri, topRightTri, bottomLeftTri};
-                    GColor triColors[3] = {topLeftColor, topRightColor, bottomLeftColor};
-                    GPoint triVerts2[3] = {topRightTri, bottomRightTri, bottomLeftTri};
-                    GColor triColors2[3] = {topRightColor, bottomRightColor, bottomLeftColor};
-                    int indices[3] = {0, 1, 2};
-
-                    drawMesh(triVerts, triColors, nullptr, 1, indices, source);
-                    drawMesh(triVerts2, triColors2, nullptr, 1, indices, source);
+            int accum = 0, L = 0;
+            size_t i = 0;
+            while(i < fActive.size()){
+                edge* e = fActive[i];
+                float x = e->curX;
+                if(accum == 0) L = GRoundToInt(x);
+                accum += e->winding;
+                if(accum == 0){
+                    //curve edges aren't clipped in x, so pin the span to the device
+                    int R = std::min(GRoundToInt(x), fDevice.width());
+                    L = std::max(L, 0);
+                    if(L < R)
+                        span(y, L, R);
                 }
+
+                e->advance(y);
+                if(e->lastY(y))
+                    fActive.erase(fActive.begin() + i);
+                else
+                    ++i;
             }
-            return;
+            assert(accum == 0);
+            ++y;
+
+            //resort in x
+            std::sort(fActive.begin(), fActive.end(), &edge_sorter2);
         }
+    }
 
-        if(texs != nullptr){
-            GPoint tex1 = texs[0];
-            GPoint tex2 = texs[1];
+    // Bilinear interpolation across a quad's corners, given clockwise from the top left.
+    template <typename T> static T quadLerp(const T corners[4], float u, float v){
+        T top = corners[0] + (corners[1] - corners[0]) * u;
+        T bottom = corners[3] + (corners[2] - corners[3]) * u;
+        return top + (bottom - top) * v;
+    }
 
-            for(int i = 0; i < divisions; ++i){
-                for(int j = 0; j < divisions; ++j){
-                    GPoint point = topLeft + (topRight - topLeft) * j * step;
-                    GPoint texture = tex1 + (tex2 - tex1) * j * step;
-                    quad[i][j] = point;
-                    quadTex[i][j] = texture;
-                }
-                topLeft += (verts[3] - verts[0]) * step;
-                topRight += (verts[2] - verts[1]) * step;
-                tex1 += (texs[3] - texs[0]) * step;
-                tex2 += (texs[2] - texs[1]) * step;
-            }
+    /**
+     *  Given a value at each of a triangle's vertices (a color, texture coordinate, ...) and the
+     *  inverse of its device-space basis (see drawMesh), return how the interpolated value
+     *  changes per device pixel in x and in y, and its value at the device origin, so spans can
+     *  step the value instead of mapping every pixel.
+     */
+    template <typename T> static void vertexGradient(const T values[3], const GMatrix& inverse, T* dx, T* dy, T* origin){
+        T e2 = values[2] - values[0];
+        T e1 = values[1] - values[0];
+        *dx = e2 * inverse[0] + e1 * inverse[3];
+        *dy = e2 * inverse[1] + e1 * inverse[4];
+        *origin = values[0] + e2 * inverse[2] + e1 * inverse[5];
+    }
 
-            for(int i = 0; i < divisions-1; ++i){
-                for(int j = 0; j < divisions-1; ++j){
-                    GPoint topLeftTri = quad[i][j];
-                    GPoint topRightTri = quad[i][j+1];
-                    GPoint bottomLeftTri = quad[i+1][j];
-                    GPoint bottomRightTri = quad[i+1][j+1];
-
-                    GPoint topLeftTex = quadTex[i][j];
-                    GPoint topRightTex = quadTex[i][j+1];
-                    GPoint bottomLeftTex = quadTex[i+1][j];
-                    GPoint bottomRightTex = quadTex[i+1][j+1];
-
-                    GPoint triVerts[3] = {topLeftTri, topRightTri, bottomLeftTri};
-                    GPoint triTex[3] = {topLeftTex, topRightTex, bottomLeftTex};
-                    GPoint triVerts2[3] = {topRightTri, bottomRightTri, bottomLeftTri};
-                    GPoint triTex2[3] = {topRightTex, bottomRightTex, bottomLeftTex};
-                    int indices[3] = {0, 1, 2};
-
-                    drawMesh(triVerts, nullptr, triTex, 1, indices, source);
-                    drawMesh(triVerts2, nullptr, triTex2, 1, indices, source);
-                }
-            }
+    /**
+     *  Prepare the paint's shader for a draw covering device columns [left, right), starting at
+     *  row top. If every row would be the same, the row is shaded once here and reused by
+     *  shadeSpan(). Returns false if nothing should be drawn.
+     */
+    bool beginShade(const GPaint& paint, int left, int right, int top){
+        GShader* shader = paint.getShader();
+        State& state = fStates.back();
+        if(!state.inverseValid){
+            state.invertible = state.ctm.invert(&state.inverse);
+            state.inverseValid = true;
+        }
+        if(!state.invertible || !shader->setContext(state.ctm, state.inverse))
+            return false;
+        fShader = shader;
+        fMode = paint.getBlendMode();
+        fAlpha = GRoundToInt(GPinToUnit(paint.getAlpha()) * 255);
+        fRowProc = blendRowProc(fMode, shader->isOpaque());
+        fInvariance = shader->invariance();
+        fRowLeft = std::max(left, 0);
+        right = std::min(right, fDevice.width());
+        if((fInvariance & GShader::kY_Invariance) && !(fInvariance & GShader::kX_Invariance) && fRowLeft < right)
+            shader->shadeRow(fRowLeft, top, right - fRowLeft, fRow.data());
+        return true;
+    }
+
+    /**
+     *  Shade [L, R) on row y, scale it by the paint's alpha and blend it into the device, all in
+     *  one pass over the span. beginShade() must be called first.
+     */
+    void shadeSpan(int y, int L, int R){
+        if(L >= R)
+            return;
+        if(fInvariance & GShader::kX_Invariance){ //one color for the whole span
+            GPixel src;
+            fShader->shadeRow(L, y, 1, &src);
+            src = scalePixel(src, fAlpha);
+            BlendProc ptr = changeBlend(src, fMode);
+            if(ptr != kDst)
+                blit(&src, fDevice, y, y+1, L, R, ptr);
             return;
         }
 
+        const GPixel* row;
+        if(fInvariance & GShader::kY_Invariance)
+            row = &fRow[L - fRowLeft];
+        else{
+            fShader->shadeRow(L, y, R-L, fRow.data());
+            row = fRow.data();
+        }
 
+        fRowProc(fDevice.getAddr(L, y), row, R-L, fAlpha);
     }
 
-private:
-    const GBitmap fDevice;
-    std::stack<GMatrix> fCTM;
+    // The bitmap drawn into: the canvas's, or the top layer's.
+    GBitmap fDevice;
+
+    // The state save() pushes: the CTM (which caches its own type), and its inverse for shaders.
+    // The inverse is only computed when a shaded draw needs it, once per change to the CTM rather
+    // than once per draw. The stack is a flat array, reserved so saves rarely allocate.
+    struct State{
+        GMatrix ctm;
+        GMatrix inverse;
+        bool inverseValid;
+        bool invertible;
+    };
+    static const int kReservedStates = 32;
+    std::vector<State> fStates;
+
+    const GMatrix& getCTM() const { return fStates.back().ctm; }
+
+    void setCTM(const GMatrix& ctm){
+        State& state = fStates.back();
+        state.ctm = ctm;
+        state.inverseValid = false;
+    }
+
+    // saveLayer() state. Each layer remembers the device it will be blended onto, and where,
+    // and is restored by the restore() that brings fStates back below depth. Restored layers' pixel
+    // buffers are pooled for the next ones.
+    struct Layer{
+        GBitmap parent;
+        int left, top;
+        size_t depth;
+        unsigned alpha;
+        GBlendMode mode;
+        bool empty;
+        std::vector<GPixel> pixels;
+    };
+    static const int kLayerPoolSize = 4;
+    std::vector<Layer> fLayers;
+    std::vector<std::vector<GPixel>> fLayerPool;
+
+    // Per-draw shader state, set by beginShade(). fRow and fColorRow are scratch rows one device
+    // row wide.
+    std::vector<GPixel> fRow;
+    std::vector<GPixel> fColorRow;
+    GShader* fShader;
+    GBlendMode fMode;
+    unsigned fAlpha;
+    int fRowLeft;
+    int fInvariance;
+    BlendRowProc fRowProc;
+
+    // drawPath() edges, and recently built edges keyed by path generation ID and matrix. Paths
+    // with more than kMaxCachedEdges edges aren't kept, so one huge path can't pin its edges.
+    struct PathCacheEntry{
+        uint32_t genID = 0;
+        GMatrix matrix;
+        GRect bounds;
+        std::vector<edge> edges;
+        unsigned lastUse = 0;
+    };
+    static const int kPathCacheSize = 8;
+    static const size_t kMaxCachedEdges = 4096;
+    std::vector<edge> fPathEdges;
+    // drawPath() scan state: copies of the edges the scan has reached, and the active ones.
+    std::vector<edge> fActiveEdges;
+    std::vector<edge*> fActive;
+    std::vector<GPoint> fPathPoints;
+    PathCacheEntry fPathCache[kPathCacheSize];
+    unsigned fPathCacheClock = 0;
+
+    std::vector<GPoint> fMeshPoints;
+    std::vector<MeshTriangle> fMeshTriangles;
+
+    // drawQuad() scratch: the tessellated grid handed to drawMesh().
+    std::vector<GPoint> fQuadPoints;
+    std::vector<GColor> fQuadColors;
+    std::vector<GPoint> fQuadTexs;
+    std::vector<int> fQuadIndices;
 };
 
 std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& device) {
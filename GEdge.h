@@ -3,11 +3,26 @@
 
 #include <assert.h>
 
-struct edge{ 
+#include "include/GMath.h"
+#include "include/GPoint.h"
+
+/**
+ *  A line, or a curve that is monotonic in y, as seen by the scan converter. A curve is stepped
+ *  as a chain of line segments that are only generated (by forward differencing) when the scan
+ *  reaches them, so a whole curve is a single entry in the edge list.
+ */
+struct edge{
     int top, bottom;
     float m, curX;
     int winding;
-    
+
+    // Curve state: segments left to generate, the row the current segment ends at, the last
+    // generated point, its forward differences, and the curve's end point. Lines have no
+    // segments left and end at bottom.
+    int segments;
+    int segBottom;
+    GPoint pt, d1, d2, d3, last;
+
     bool lastY(int y) const{
         assert(y >= top && y < bottom);
         return y == bottom - 1;
@@ -17,6 +32,59 @@ struct edge{
         assert(y >= 0 && y < bottom);
         return y >= top && y < bottom;
     }
+
+    // Move curX from row y to row y+1.
+    void advance(int y){
+        if(y + 1 == segBottom && segments > 0)
+            nextSegment();
+        else
+            curX += m;
+    }
+
+    /**
+     *  Generate segments until one reaches past row segBottom, and start it there. Segments too
+     *  short to cross a pixel center are folded into the next. Returns false once the curve is
+     *  used up.
+     */
+    bool nextSegment(){
+        while(segments > 0){
+            GPoint p0 = pt;
+            GPoint p1 = --segments == 0 ? last : pt + d1;
+            d1 += d2;
+            d2 += d3;
+            pt = p1;
+
+            int b = GRoundToInt(p1.y());
+            if(b <= segBottom)
+                continue;
+            m = (p1.x() - p0.x()) / (p1.y() - p0.y());
+            curX = p0.x() + m * (segBottom + .5f - p0.y());
+            segBottom = b;
+            return true;
+        }
+        return false;
+    }
+
+    // Move the edge by dx, and by whole rows in y.
+    void offset(float dx, int dy){
+        top += dy;
+        bottom += dy;
+        segBottom += dy;
+        curX += dx;
+        pt += {dx, (float)dy};
+        last += {dx, (float)dy};
+    }
+
+    // Start the edge at row y (top < y < bottom), skipping the segments above it.
+    void skipTo(int y){
+        int start = top;
+        while(segBottom <= y && segments > 0){
+            start = segBottom;
+            nextSegment();
+        }
+        curX += m * (y - start);
+        top = y;
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,141 @@
 #include "include/GFinal.h"
 #include "include/GBitmap.h"
 #include "GTools.h"
+#include "GPathMeasure.h"
+#include "GStroker.h"
+#include "GTriangle.h"
+
+#if defined(__SSE2__)
+// The radial parameter is a distance, so t >= 0 and truncation is the same as floor.
+static inline __m128 floor_pos(__m128 v){
+    return _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+}
+
+template <GShader::TileMode mode> static inline __m128 tileRadial(__m128 t);
+template <> inline __m128 tileRadial<GShader::kClamp>(__m128 t){
+    return _mm_min_ps(t, _mm_set1_ps(1));
+}
+template <> inline __m128 tileRadial<GShader::kRepeat>(__m128 t){
+    return _mm_sub_ps(t, floor_pos(t));
+}
+template <> inline __m128 tileRadial<GShader::kMirror>(__m128 t){
+    __m128 half = _mm_mul_ps(t, _mm_set1_ps(.5f));
+    __m128 m = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(half, floor_pos(half)), _mm_set1_ps(2)), _mm_set1_ps(1));
+    __m128 absM = _mm_andnot_ps(_mm_set1_ps(-0.f), m);
+    return _mm_sub_ps(_mm_set1_ps(1), absM);
+}
+#endif
+
+/**
+ *  Radial gradient. Distances are evaluated 8 pixels at a time (two SSE vectors when available),
+ *  with the tile mode picked once per row.
+ */
+class GRadialGradientShader : public GShader {
+public:
+    GRadialGradientShader(GPoint center, float radius, const GColor colors[], int count, GShader::TileMode mode)
+        : fCenter(center), fInvRadius(1 / radius), fCount(count), fMode(mode) {
+        fColors = new GColor[count+1];
+        fColors[0] = colors[0];
+        fColors[0].pinToUnit();
+        for(int i = 1; i < count; ++i)
+            fColors[i] = colors[i];
+        fColors[count] = fColors[count-1];
+
+        fDeltas = new GColor[count];
+        for(int i = 0; i < count; ++i)
+            fDeltas[i] = fColors[i+1] - fColors[i];
+    }
+
+    ~GRadialGradientShader(){
+        delete[] fColors;
+        delete[] fDeltas;
+    }
+
+    bool isOpaque() override{
+        for(int i = 0; i < fCount; ++i){
+            if(fColors[i].a < 1){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool setContext(const GMatrix& ctm) override {
+        return ctm.invert(&fInv);
+    }
+
+    bool setContext(const GMatrix& ctm, const GMatrix& inverse) override {
+        fInv = inverse;
+        return true;
+    }
+
+    void shadeRow(int x, int y, int count, GPixel row[]) override {
+        switch(fMode){
+            case kClamp:  shade<kClamp>(x, y, count, row);  break;
+            case kRepeat: shade<kRepeat>(x, y, count, row); break;
+            case kMirror: shade<kMirror>(x, y, count, row); break;
+        }
+    }
+
+private:
+    template <TileMode mode> void shade(int x, int y, int count, GPixel row[]) {
+        GPoint pt = fInv * GPoint{x + .5f, y + .5f};
+        float dx = pt.x() - fCenter.x();
+        float dy = pt.y() - fCenter.y();
+        float t[8];
+
+        for(int i = 0; i < count; i += 8){
+            //each lane is offset from the first pixel, rather than accumulated, to avoid drift
+            distances<mode>(dx + i * fInv[0], dy + i * fInv[3], t);
+            int n = std::min(8, count - i);
+            for(int k = 0; k < n; ++k)
+                row[i+k] = lookup(t[k]);
+        }
+    }
+
+    // Writes the tiled gradient parameter for the 8 pixels starting at (dx, dy) into t[].
+    template <TileMode mode> void distances(float dx, float dy, float t[8]) const {
+#if defined(__SSE2__)
+        const __m128 stepX = _mm_set1_ps(fInv[0]);
+        const __m128 stepY = _mm_set1_ps(fInv[3]);
+        const __m128 invRadius = _mm_set1_ps(fInvRadius);
+        const __m128 lanes[2] = {_mm_setr_ps(0, 1, 2, 3), _mm_setr_ps(4, 5, 6, 7)};
+        for(int h = 0; h < 2; ++h){
+            __m128 x = _mm_add_ps(_mm_set1_ps(dx), _mm_mul_ps(lanes[h], stepX));
+            __m128 y = _mm_add_ps(_mm_set1_ps(dy), _mm_mul_ps(lanes[h], stepY));
+            __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+            _mm_storeu_ps(t + 4*h, tileRadial<mode>(_mm_mul_ps(d, invRadius)));
+        }
+#else
+        for(int k = 0; k < 8; ++k){
+            float x = dx + k * fInv[0];
+            float y = dy + k * fInv[3];
+            t[k] = tileUnit<mode>(sqrtf(x*x + y*y) * fInvRadius);
+        }
+#endif
+    }
+
+    // t is already tiled into [0, 1].
+    GPixel lookup(float t) const {
+        float s = t * (fCount - 1);
+        int j = (int)s;
+        float w = s - j;
+#if defined(__SSE2__)
+        __m128 c = _mm_add_ps(_mm_loadu_ps(&fColors[j].r), _mm_mul_ps(_mm_set1_ps(w), _mm_loadu_ps(&fDeltas[j].r)));
+        return makePixel(c);
+#else
+        return makePixel(fColors[j] + w * fDeltas[j]);
+#endif
+    }
+
+    GMatrix fInv;
+    GPoint fCenter;
+    float fInvRadius;
+    GColor* fColors;
+    GColor* fDeltas;
+    int fCount;
+    GShader::TileMode fMode;
+};
 
 class Final : public GFinal {
 public:
@@ -16,83 +151,6 @@ public:
     std::unique_ptr<GShader> createRadialGradient(GPoint center, float radius,
                                                           const GColor colors[], int count,
                                                           GShader::TileMode mode) {
-        class GRadialGradientShader : public GShader {
-            public:
-                GRadialGradientShader (GPoint center, float radius, const GColor colors[], int count, GShader::TileMode mode) : fCenter(center), fRadius(radius), fCount(count), fMode(mode) {
-                    fColors = new GColor[count+1];
-                    fColors[0] = colors[0];
-                    fColors[0].pinToUnit();
-                    // fColors[1] = fColors[0];
-                    for(int i = 1; i < count; ++i)
-                        fColors[i] = colors[i];
-                    fColors[count] = fColors[count-1];
-                }
-
-                bool isOpaque(){
-                    for(int i = 0; i < fCount; ++i){
-                        if(fColors[i].a < 1){
-                            return false;
-                        }
-                    }
-                    return true;
-                }
-                
-                bool setContext(const GMatrix& ctm) override {
-                    bool success = ctm.invert(&fInv);
-                    return success;
-                }
-
-                void shadeRow(int x, int y, int count, GPixel row[]) override {
-                    GPoint pt = {x + .5f, y + .5f};
-                    fInv.mapPoints(&pt, 1);
-                    for(int i = 0; i < count; ++i){
-                        float dx = pt.x() - fCenter.x();
-                        float dy = pt.y() - fCenter.y();
-
-                        float distance = sqrtf(dx*dx + dy*dy);
-
-                        float t = distance / fRadius;
-
-                        if(fMode == kRepeat){
-                            if(t > 1)
-                                t = t - floor(t);
-                        }
-                        if(fMode == kMirror){
-                            if(t > 1){
-                                if(GFloorToInt(t) % 2 == 1){
-                                    t = t - floor(t);
-                                    t = 1 - t;  
-                                }
-                                else{
-                                    t = t - floor(t);
-                                }
-                            }
-                        }
-                        t = std::max(t, 0.0f);
-                        t = std::min(t, 1.0f);
-                        
-
-                        int j = floor(t * (fCount - 1));
-                        float span = 1.0f / (fCount - 1);
-                        float start = j * span;
-                        if(t != 0 && t != 1)
-                            t = (t - start) / span;
-
-                        GColor currentColor = t * (fColors[j+1] - fColors[j]) + fColors[j];
-                        row[i] = makePixel(currentColor);
-                        pt.fX += fInv[0];
-                        pt.fY += fInv[3];
-                    }
-                }
-
-            private:
-                GMatrix fInv;
-                GPoint fCenter;
-                float fRadius;
-                GColor* fColors;
-                int fCount;
-                GShader::TileMode fMode;
-        };
         if(count < 1)
             return nullptr;
 
@@ -118,9 +176,13 @@ public:
 
             // The draw calls in GCanvas must call this with the CTM before any calls to shadeSpan().
             bool setContext(const GMatrix& ctm) override {
-                bool success = ctm.invert(&fInv);
-                fInv = fLocalInverse * fInv;
-                return success;
+                GMatrix inverse;
+                return ctm.invert(&inverse) && setContext(ctm, inverse);
+            }
+
+            bool setContext(const GMatrix& ctm, const GMatrix& inverse) override {
+                fInv = fLocalInverse * inverse;
+                return true;
             }
 
             void shadeRow(int x, int y, int count, GPixel row[]) override {
@@ -173,54 +235,20 @@ public:
      *  other, ala its thickness.
      */
     void addLine(GPath* path, GPoint p0, GPoint p1, float width, CapType cap) {
-        float slope = (p1.y() - p0.y()) / (p1.x() - p0.x());
-        float angle = atan(-1/slope);
-        float dx = width/2 * sin(angle);
-        float dy = width/2 * cos(angle);
-
-        GPoint left = (p0.x() < p1.x()) ? p0 : p1;
-        GPoint right = (p0.x() < p1.x()) ? p1 : p0;
-
-        if(slope == 0){
-            dx = 0;
-            dy = width/2;
-        }
+        GPath line;
+        line.moveTo(p0).lineTo(p1);
+        ::strokePath(path, line, width, cap, kMiterJoin, 4);
+    }
 
-        if(cap == kSquare){
-            float angle = atan(slope);
-            float dx = width/2 * sin(angle);
-            float dy = width/2 * cos(angle);
-            if(slope == 0){
-                dx = width/2;
-                dy = 0;
-            }
-            left = {p0.x() - dx, p0.y() - dy};
-            right = {p1.x() + dx, p1.y() + dy};
-        }
+    // See strokePath() in GStroker.h.
+    void strokePath(GPath* dst, const GPath& src, float width, CapType cap, JoinType join,
+                    float miterLimit) {
+        ::strokePath(dst, src, width, cap, join, miterLimit);
+    }
 
-        path->moveTo({left.x() + dx, left.y() + dy});
-        path->lineTo({left.x() - dx, left.y() - dy});
-        path->lineTo({right.x() - dx, right.y() - dy});
-        path->lineTo({right.x() + dx, right.y() + dy});
-
-        if(cap == kRound){
-            float radius = width/2;
-            GPath::Direction direction = GPath::kCW_Direction;
-            if(slope > 0){
-                if(p0.y() < p1.y())
-                    direction = GPath::kCW_Direction;
-                else direction = GPath::kCCW_Direction;
-            }
-            else{
-                if(p0.y() < p1.y())
-                    direction = GPath::kCCW_Direction;
-                else direction = GPath::kCW_Direction;
-            }
-                
-            path->addCircle(p0, radius, direction);
-            path->addCircle(p1, radius, direction);
-        }
-        
+    // See dashPath() in GPathMeasure.h.
+    void dashPath(GPath* dst, const GPath& src, const float intervals[], int count, float phase) {
+        ::dashPath(dst, src, intervals, count, phase);
     }
 
      /*
@@ -244,7 +272,75 @@ public:
      *      Corners is computed by our standard "drawQuad" evaluation using the 4 corners 0,2,4,6
      */
     virtual void drawQuadraticCoons(GCanvas* canvas, const GPoint pts[8], const GPoint tex[4],
-                                    int level, const GPaint& paint) {}
+                                    int level, const GPaint& paint) {
+        if(level < 0)
+            return;
+
+        //each boundary curve is evaluated once per grid line, not once per vertex
+        int divisions = level + 2;
+        fTop.resize(divisions);
+        fBottom.resize(divisions);
+        fLeft.resize(divisions);
+        fRight.resize(divisions);
+        evalQuadratic(pts[0], pts[1], pts[2], divisions, fTop.data());
+        evalQuadratic(pts[6], pts[5], pts[4], divisions, fBottom.data());
+        evalQuadratic(pts[0], pts[7], pts[6], divisions, fLeft.data());
+        evalQuadratic(pts[2], pts[3], pts[4], divisions, fRight.data());
+
+        float step = 1.0f/(divisions - 1);
+        fPoints.resize(divisions * divisions);
+        fTexs.resize(divisions * divisions);
+        for(int i = 0; i < divisions; ++i){
+            float v = i == divisions - 1 ? 1 : i * step;
+            for(int j = 0; j < divisions; ++j){
+                float u = j == divisions - 1 ? 1 : j * step;
+                GPoint tb = fTop[j] + (fBottom[j] - fTop[j]) * v;
+                GPoint lr = fLeft[i] + (fRight[i] - fLeft[i]) * u;
+                GPoint corners = bilerp(pts[0], pts[2], pts[4], pts[6], u, v);
+                fPoints[i * divisions + j] = tb + lr - corners;
+                fTexs[i * divisions + j] = bilerp(tex[0], tex[1], tex[2], tex[3], u, v);
+            }
+        }
+
+        fIndices.resize((divisions - 1) * (divisions - 1) * 6);
+        gridIndices(divisions, fIndices.data());
+
+        canvas->drawMesh(fPoints.data(), nullptr, fTexs.data(), (divisions - 1) * (divisions - 1) * 2, fIndices.data(), paint);
+    }
+
+private:
+    // Corners are clockwise from the top left.
+    static GPoint bilerp(GPoint p0, GPoint p1, GPoint p2, GPoint p3, float u, float v){
+        GPoint top = p0 + (p1 - p0) * u;
+        GPoint bottom = p3 + (p2 - p3) * u;
+        return top + (bottom - top) * v;
+    }
+
+    /**
+     *  Evaluate the quadratic bezier p0, p1, p2 at count evenly spaced t in [0, 1] by forward
+     *  differencing: two adds per point. The last point is pinned to p2 so neighbouring grid
+     *  lines meet exactly.
+     */
+    static void evalQuadratic(GPoint p0, GPoint p1, GPoint p2, int count, GPoint out[]){
+        float h = 1.0f/(count - 1);
+        GPoint a = p0 - p1 * 2 + p2;
+        GPoint b = (p1 - p0) * 2;
+        GPoint value = p0;
+        GPoint d1 = a * (h * h) + b * h;
+        GPoint d2 = a * (2 * h * h);
+        for(int i = 0; i < count - 1; ++i){
+            out[i] = value;
+            value += d1;
+            d1 += d2;
+        }
+        out[count - 1] = p2;
+    }
+
+    // drawQuadraticCoons() scratch, reused across calls.
+    std::vector<GPoint> fTop, fBottom, fLeft, fRight;
+    std::vector<GPoint> fPoints;
+    std::vector<GPoint> fTexs;
+    std::vector<int> fIndices;
 };
 
 /**
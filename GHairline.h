@@ -0,0 +1,131 @@
+#ifndef GHairline_DEFINED
+#define GHairline_DEFINED
+
+#include "include/GPoint.h"
+#include "include/GRect.h"
+
+// Same as GFloorToInt(), without the call to floorf() (x must fit in an int).
+static inline int hairlineFloor(float x){
+    int i = (int)x;
+    return i - (x < i);
+}
+
+/**
+ *  Scan converts a device-space line one pixel wide, calling blitter(L, T, R, B) for each run of
+ *  pixels it covers inside clip (a row of pixels for mostly horizontal lines, a column for mostly
+ *  vertical ones). Along the major axis a pixel is covered when its center is between the ends
+ *  (rounded like the rest of the canvas), and it sits in the row (or column) the line crosses
+ *  that center in, so either direction covers the same pixels. Only the part inside clip is
+ *  stepped, so the cost is the visible length of the line.
+ *
+ *  The pixel (skipX, skipY) is left out, and (lastX, lastY) is set to the line's last pixel going
+ *  from p0 to p1, clipped or not. Returns false if the line covers no pixels.
+ */
+template <typename Blitter> bool scanHairline(GPoint p0, GPoint p1, const GIRect& clip, int skipX, int skipY,
+                                              int* lastX, int* lastY, Blitter&& blitter){
+    float dx = p1.x() - p0.x();
+    float dy = p1.y() - p0.y();
+    if(dx == 0 && dy == 0)
+        return false;
+
+    //blit [L, R) x [T, B), less the skipped pixel
+    auto run = [&](int L, int T, int R, int B){
+        if(skipX < L || skipX >= R || skipY < T || skipY >= B){
+            blitter(L, T, R, B);
+            return;
+        }
+        if(T < skipY) blitter(L, T, R, skipY);
+        if(L < skipX) blitter(L, skipY, skipX, skipY + 1);
+        if(skipX + 1 < R) blitter(skipX + 1, skipY, R, skipY + 1);
+        if(skipY + 1 < B) blitter(L, skipY + 1, R, B);
+    };
+
+    bool xMajor = std::abs(dx) >= std::abs(dy);
+    bool reversed = xMajor ? dx < 0 : dy < 0;
+    if(reversed)
+        std::swap(p0, p1);
+    if(xMajor){ //one pixel per column, in runs along each row
+        float slope = dy / dx;
+        auto rowAt = [&](int x){ return hairlineFloor(p0.y() + (x + .5f - p0.x()) * slope); };
+        int first = GRoundToInt(p0.x());
+        int end = GRoundToInt(p1.x());
+        if(first >= end)
+            return false;
+        *lastX = reversed ? first : end - 1;
+        *lastY = rowAt(*lastX);
+
+        int left = std::max(first, clip.left());
+        int right = std::min(end, clip.right());
+        if(slope == 0){ //e.g. grid lines, one run
+            if(left < right && *lastY >= clip.top() && *lastY < clip.bottom())
+                run(left, *lastY, right, *lastY + 1);
+            return true;
+        }
+        int runL = left, runY = 0;
+        for(int x = left; x < right; ++x){
+            int y = rowAt(x);
+            if(x == runL)
+                runY = y;
+            else if(y != runY){
+                if(runY >= clip.top() && runY < clip.bottom())
+                    run(runL, runY, x, runY + 1);
+                runL = x;
+                runY = y;
+            }
+        }
+        if(runL < right && runY >= clip.top() && runY < clip.bottom())
+            run(runL, runY, right, runY + 1);
+    }
+    else{ //one pixel per row, in runs down each column
+        float slope = dx / dy;
+        auto columnAt = [&](int y){ return hairlineFloor(p0.x() + (y + .5f - p0.y()) * slope); };
+        int first = GRoundToInt(p0.y());
+        int end = GRoundToInt(p1.y());
+        if(first >= end)
+            return false;
+        *lastY = reversed ? first : end - 1;
+        *lastX = columnAt(*lastY);
+
+        int top = std::max(first, clip.top());
+        int bottom = std::min(end, clip.bottom());
+        if(slope == 0){
+            if(top < bottom && *lastX >= clip.left() && *lastX < clip.right())
+                run(*lastX, top, *lastX + 1, bottom);
+            return true;
+        }
+        int runT = top, runX = 0;
+        for(int y = top; y < bottom; ++y){
+            int x = columnAt(y);
+            if(y == runT)
+                runX = x;
+            else if(x != runX){
+                if(runX >= clip.left() && runX < clip.right())
+                    run(runX, runT, runX + 1, y);
+                runT = y;
+                runX = x;
+            }
+        }
+        if(runT < bottom && runX >= clip.left() && runX < clip.right())
+            run(runX, runT, runX + 1, bottom);
+    }
+    return true;
+}
+
+/**
+ *  Scan converts the polyline through pts[0...count-1] as hairlines (see scanHairline()). Where
+ *  two lines meet, the second leaves out the first's last pixel, so no pixel at a joint is
+ *  blitted twice.
+ */
+template <typename Blitter> void scanHairlines(const GPoint pts[], int count, const GIRect& clip, Blitter&& blitter){
+    //nothing is skipped until a line has drawn something
+    int lastX = clip.left() - 1, lastY = clip.top() - 1;
+    for(int i = 1; i < count; ++i){
+        int x, y;
+        if(scanHairline(pts[i-1], pts[i], clip, lastX, lastY, &x, &y, blitter)){
+            lastX = x;
+            lastY = y;
+        }
+    }
+}
+
+#endif
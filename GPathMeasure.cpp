@@ -0,0 +1,228 @@
+#include "GPathMeasure.h"
+
+#include <algorithm>
+
+// Curves are measured as chords that stay this close to the curve (finer than the rasterizer
+// flattens to, since chords come up short and dashes add up the error along a contour).
+static const float kCurveTolerance = .05f;
+static const int kMaxCurvePieces = 1024;
+// More repeats of a dash pattern than this along one contour and the dashes would be too small
+// to see, or too small for the distances to step past in floats.
+static const float kMaxDashPatterns = 1000000;
+
+static GPoint evalSegment(GPath::Verb verb, const GPoint pts[], float t){
+    float s = 1 - t;
+    switch(verb){
+        case GPath::kQuad:
+            return pts[0] * (s * s) + pts[1] * (2 * s * t) + pts[2] * (t * t);
+        case GPath::kCubic:
+            return pts[0] * (s * s * s) + pts[1] * (3 * s * s * t) + pts[2] * (3 * s * t * t) + pts[3] * (t * t * t);
+        default:
+            return pts[0] + (pts[1] - pts[0]) * t;
+    }
+}
+
+// Append the part of the segment from t0 to t1 to dst's current contour.
+static void appendPart(GPath::Verb verb, const GPoint pts[], float t0, float t1, GPath* dst){
+    if(verb == GPath::kLine){
+        dst->lineTo(evalSegment(verb, pts, t1));
+        return;
+    }
+    //chop off the end at t1, then the start at t0 (which is t0/t1 along what's left)
+    if(verb == GPath::kQuad){
+        GPoint part[5] = {pts[0], pts[1], pts[2]};
+        if(t1 < 1)
+            GPath::ChopQuadAt(pts, part, t1);
+        if(t0 > 0)
+            GPath::ChopQuadAt(part, part, t0 / t1);
+        const GPoint* q = t0 > 0 ? part + 2 : part;
+        dst->quadTo(q[1], q[2]);
+        return;
+    }
+    GPoint part[7] = {pts[0], pts[1], pts[2], pts[3]};
+    if(t1 < 1)
+        GPath::ChopCubicAt(pts, part, t1);
+    if(t0 > 0)
+        GPath::ChopCubicAt(part, part, t0 / t1);
+    const GPoint* c = t0 > 0 ? part + 3 : part;
+    dst->cubicTo(c[1], c[2], c[3]);
+}
+
+GPathMeasure::GPathMeasure(const GPath& path){
+    GPath::Iter iter(path);
+    GPoint pts[GPath::kMaxNextPoints];
+    GPath::Verb verb;
+    Contour contour = {0, 0, 0};
+    //segments with no length add no pieces, so a contour with no length has nothing to drop
+    auto endContour = [&](){
+        contour.endPiece = (int)fPieces.size();
+        if(contour.length > 0)
+            fContours.push_back(contour);
+    };
+    while((verb = iter.next(pts)) != GPath::kDone){
+        if(verb == GPath::kMove){
+            endContour();
+            contour = {(int)fPieces.size(), 0, 0};
+        }
+        else
+            addSegment(verb, pts, &contour.length);
+    }
+    endContour();
+}
+
+void GPathMeasure::addSegment(GPath::Verb verb, const GPoint pts[], float* length){
+    int k = 1;
+    if(verb == GPath::kQuad){
+        GPoint a = pts[0] - pts[1] * 2 + pts[2];
+        k = (int)ceilf(sqrtf(a.length() / (4 * kCurveTolerance)));
+    }
+    if(verb == GPath::kCubic){
+        GPoint a = pts[0] - pts[1] * 2 + pts[2];
+        GPoint b = pts[1] - pts[2] * 2 + pts[3];
+        float d = std::max(a.length(), b.length());
+        k = (int)ceilf(sqrtf(d * .75f / kCurveTolerance));
+    }
+    k = std::min(std::max(k, 1), kMaxCurvePieces);
+
+    int first = (int)fPieces.size();
+    GPoint prev = pts[0];
+    float distance = *length;
+    for(int i = 1; i <= k; ++i){
+        float t = (float)i / k;
+        GPoint p = evalSegment(verb, pts, t);
+        float d = (p - prev).length();
+        prev = p;
+        if(d == 0)
+            continue;
+        distance += d;
+        fPieces.push_back({distance, t, (int)fSegments.size()});
+    }
+    if((int)fPieces.size() == first) //no length
+        return;
+    //the last piece ends the segment exactly
+    fPieces.back().t = 1;
+
+    Segment segment;
+    segment.verb = verb;
+    int count = verb == GPath::kCubic ? 4 : verb == GPath::kQuad ? 3 : 2;
+    std::copy(pts, pts + count, segment.pts);
+    fSegments.push_back(segment);
+    *length = distance;
+}
+
+float GPathMeasure::locate(const Contour& contour, float d, int* cursor, int* segment) const{
+    int i = *cursor;
+    while(i < contour.endPiece - 1 && fPieces[i].distance < d)
+        ++i;
+    *cursor = i;
+
+    const Piece& piece = fPieces[i];
+    *segment = piece.segment;
+    float prevDistance = i > contour.firstPiece ? fPieces[i-1].distance : 0;
+    float prevT = i > contour.firstPiece && fPieces[i-1].segment == piece.segment ? fPieces[i-1].t : 0;
+    float span = piece.distance - prevDistance;
+    float t = prevT + (piece.t - prevT) * (d - prevDistance) / span;
+    return std::min(std::max(t, prevT), piece.t);
+}
+
+bool GPathMeasure::appendSegment(const Contour& contour, float start, float stop, int* cursor, GPath* dst, bool startWithMoveTo) const{
+    start = std::max(start, 0.f);
+    stop = std::min(stop, contour.length);
+    if(start > stop)
+        return false;
+
+    int s0, s1;
+    float t0 = locate(contour, start, cursor, &s0);
+    int stopCursor = *cursor;
+    float t1 = locate(contour, stop, &stopCursor, &s1);
+    *cursor = stopCursor;
+
+    const Segment& first = fSegments[s0];
+    GPoint startPt = evalSegment(first.verb, first.pts, t0);
+    if(startWithMoveTo)
+        dst->moveTo(startPt);
+    if(s0 == s1 && t1 <= t0){
+        dst->lineTo(startPt);
+        return true;
+    }
+    if(s0 == s1){
+        appendPart(first.verb, first.pts, t0, t1, dst);
+        return true;
+    }
+    if(t0 < 1)
+        appendPart(first.verb, first.pts, t0, 1, dst);
+    for(int s = s0 + 1; s < s1; ++s)
+        appendPart(fSegments[s].verb, fSegments[s].pts, 0, 1, dst);
+    if(t1 > 0)
+        appendPart(fSegments[s1].verb, fSegments[s1].pts, 0, t1, dst);
+    return true;
+}
+
+bool GPathMeasure::getSegment(int contour, float start, float stop, GPath* dst, bool startWithMoveTo) const{
+    const Contour& c = fContours[contour];
+    auto first = fPieces.begin() + c.firstPiece;
+    auto end = fPieces.begin() + c.endPiece;
+    auto piece = std::lower_bound(first, end, std::max(start, 0.f), [](const Piece& p, float d){
+        return p.distance < d;
+    });
+    int cursor = (int)(std::min(piece, end - 1) - fPieces.begin());
+    return appendSegment(c, start, stop, &cursor, dst, startWithMoveTo);
+}
+
+void dashPath(GPath* dst, const GPath& src, const float intervals[], int count, float phase){
+    float period = 0;
+    bool valid = count >= 2 && count % 2 == 0;
+    for(int i = 0; valid && i < count; ++i){
+        valid = intervals[i] >= 0;
+        period += intervals[i];
+    }
+    //a shared copy keeps the source intact if dst is src
+    GPath source = src;
+    if(!valid || !(period > 0)){
+        GPath::Iter iter(source);
+        GPoint pts[GPath::kMaxNextPoints];
+        GPath::Verb verb;
+        while((verb = iter.next(pts)) != GPath::kDone){
+            switch(verb){
+                case GPath::kMove: dst->moveTo(pts[0]); break;
+                case GPath::kLine: dst->lineTo(pts[1]); break;
+                case GPath::kQuad: dst->quadTo(pts[1], pts[2]); break;
+                case GPath::kCubic: dst->cubicTo(pts[1], pts[2], pts[3]); break;
+                default: break;
+            }
+        }
+        return;
+    }
+
+    //find where in the pattern phase lands (on a zero-length dash, that dash is kept)
+    phase = fmodf(phase, period);
+    if(phase < 0)
+        phase += period;
+    int startIndex = 0;
+    while(phase > intervals[startIndex] || (phase == intervals[startIndex] && intervals[startIndex] > 0)){
+        phase -= intervals[startIndex];
+        startIndex = (startIndex + 1) % count;
+    }
+    float startRemaining = intervals[startIndex] - phase;
+
+    //each contour walks its pieces once, as the dashes move along it
+    GPathMeasure measure(source);
+    for(const GPathMeasure::Contour& contour : measure.fContours){
+        int index = startIndex;
+        float remaining = startRemaining;
+        int cursor = contour.firstPiece;
+        if(contour.length / period > kMaxDashPatterns){ //too many dashes to tell apart, draw it solid
+            measure.appendSegment(contour, 0, contour.length, &cursor, dst, true);
+            continue;
+        }
+        float d = 0;
+        while(d < contour.length){
+            float end = std::min(d + remaining, contour.length);
+            if(index % 2 == 0)
+                measure.appendSegment(contour, d, end, &cursor, dst, true);
+            d = end;
+            index = (index + 1) % count;
+            remaining = intervals[index];
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef GPathMeasure_DEFINED
+#define GPathMeasure_DEFINED
+
+#include <vector>
+
+#include "include/GPath.h"
+
+/**
+ *  Lengths along a path's contours, and the pieces of them between two distances. Curves are
+ *  measured as chains of chords that are also used to find the curve parameter at a distance,
+ *  so a distance maps straight to a point on the curve without re-measuring it.
+ *
+ *  Like the stroker, contours are measured as drawn: a contour has no implicit closing segment.
+ *  Contours with no length are skipped.
+ */
+class GPathMeasure {
+public:
+    explicit GPathMeasure(const GPath&);
+
+    int countContours() const { return (int)fContours.size(); }
+    float length(int contour) const { return fContours[contour].length; }
+
+    /**
+     *  Append to dst the part of the contour from distance start to distance stop (clamped to the
+     *  contour), starting with a moveTo if startWithMoveTo, else continuing dst's current contour.
+     *  A part with no length is appended as a moveTo and lineTo the same point, so it can still be
+     *  stroked as a dot. Returns false, appending nothing, if start > stop.
+     */
+    bool getSegment(int contour, float start, float stop, GPath* dst, bool startWithMoveTo) const;
+
+private:
+    friend void dashPath(GPath*, const GPath&, const float[], int, float);
+
+    struct Segment {
+        GPath::Verb verb;
+        GPoint pts[4];
+    };
+    // The contour's length up to parameter t of a segment.
+    struct Piece {
+        float distance;
+        float t;
+        int segment;
+    };
+    struct Contour {
+        int firstPiece, endPiece;
+        float length;
+    };
+
+    std::vector<Segment> fSegments;
+    std::vector<Piece> fPieces;
+    std::vector<Contour> fContours;
+
+    void addSegment(GPath::Verb, const GPoint pts[], float* length);
+    // The segment and parameter at distance d, searching the contour's pieces from *cursor on.
+    float locate(const Contour&, float d, int* cursor, int* segment) const;
+    bool appendSegment(const Contour&, float start, float stop, int* cursor, GPath* dst, bool startWithMoveTo) const;
+};
+
+/**
+ *  Append to dst the dashes of src: intervals[] alternates the lengths of dashes and the gaps
+ *  between them (count must be even), and the pattern starts phase into itself at the start of
+ *  each contour. Each dash becomes its own open contour, ready to be stroked. If the intervals
+ *  can't make a pattern (odd count, a negative interval, or all zero), src is appended as is.
+ */
+void dashPath(GPath* dst, const GPath& src, const float intervals[], int count, float phase);
+
+#endif
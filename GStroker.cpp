@@ -0,0 +1,346 @@
+#include "GStroker.h"
+
+#include <vector>
+
+// Curves are split until their direction turns less than this much (as a cosine, about 15
+// degrees) along each piece, which keeps the offset pieces well within a pixel of exact.
+static const float kFlatCos = .966f;
+// Turns smaller than this (as a cosine) need no join.
+static const float kStraightCos = .99995f;
+// A curve is split at most this many times (into 64 pieces) before it is stroked as its chord.
+static const int kMaxCurveDepth = 6;
+
+static float dot(GVector a, GVector b){
+    return a.x() * b.x() + a.y() * b.y();
+}
+
+static float cross(GVector a, GVector b){
+    return a.x() * b.y() - a.y() * b.x();
+}
+
+static bool isZero(GVector v){
+    return v.x() == 0 && v.y() == 0;
+}
+
+static GVector unit(GVector v){
+    return v * (1 / v.length());
+}
+
+// The offset to the stroke's left side, for a unit direction u and radius r.
+static GVector leftNormal(GVector u, float r){
+    return {-u.y() * r, u.x() * r};
+}
+
+/**
+ *  Append an arc of radius r about center, from unit direction a to unit direction b, as cubics
+ *  of at most 90 degrees each. The arc goes the short way round, or through the direction
+ *  "through" when a and b are opposite.
+ */
+static void arcTo(GPath* path, GPoint center, GVector a, GVector b, float r, GVector through){
+    float c = dot(a, b);
+    if(c < 0){
+        GVector mid = a + b;
+        mid = mid.length() > 1e-4f ? unit(mid) : through;
+        arcTo(path, center, a, mid, r, through);
+        arcTo(path, center, mid, b, r, through);
+        return;
+    }
+    if(c > kStraightCos){
+        path->lineTo(center + b * r);
+        return;
+    }
+    //control points sit 4/3 tan(angle/4) along the tangents, found from the cosine by half angles
+    float cosHalf = sqrtf((1 + c) / 2);
+    float sinHalf = sqrtf((1 - c) / 2);
+    float k = 4.f / 3 * sinHalf / (1 + cosHalf);
+    GVector ta = unit(b - a * c);
+    GVector tb = unit(b * c - a);
+    path->cubicTo(center + (a + ta * k) * r, center + (b - tb * k) * r, center + b * r);
+}
+
+// Append src's contours to dst.
+static void appendPath(GPath* dst, const GPath& src){
+    GPath::Iter iter(src);
+    GPoint pts[GPath::kMaxNextPoints];
+    GPath::Verb verb;
+    while((verb = iter.next(pts)) != GPath::kDone){
+        switch(verb){
+            case GPath::kMove: dst->moveTo(pts[0]); break;
+            case GPath::kLine: dst->lineTo(pts[1]); break;
+            case GPath::kQuad: dst->quadTo(pts[1], pts[2]); break;
+            case GPath::kCubic: dst->cubicTo(pts[1], pts[2], pts[3]); break;
+            default: break;
+        }
+    }
+}
+
+class Stroker {
+public:
+    Stroker(GPath* dst, float radius, GFinal::CapType cap, GFinal::JoinType join, float miterLimit)
+        : fDst(dst), fRadius(radius), fCap(cap), fJoin(join), fMiterLimit(miterLimit) {}
+
+    void moveTo(GPoint p){
+        finishContour();
+        fFirstPt = fPrevPt = p;
+    }
+
+    void lineTo(GPoint p){
+        fHasVerbs = true;
+        if(p == fPrevPt)
+            return;
+        GVector u = unit(p - fPrevPt);
+        GVector n = leftNormal(u, fRadius);
+        startSegment(u);
+        fLeft.lineTo(p + n);
+        fRight.lineTo(p - n);
+        endSegment(p, u);
+    }
+
+    // The offset of a quad whose direction barely turns is the quad between the offset end points
+    // whose control point is where the offset end tangents meet.
+    void quadTo(const GPoint pts[3], int depth){
+        fHasVerbs = true;
+        GVector u0 = pts[1] == pts[0] ? pts[2] - pts[0] : pts[1] - pts[0];
+        GVector u1 = pts[2] == pts[1] ? pts[2] - pts[0] : pts[2] - pts[1];
+        if(isZero(u0))
+            return;
+        u0 = unit(u0);
+        u1 = unit(u1);
+        float c = dot(u0, u1);
+        if(c < kFlatCos){
+            if(depth == kMaxCurveDepth){ //only a cusp gets this far
+                lineTo(pts[2]);
+                return;
+            }
+            GPoint halves[5];
+            GPath::ChopQuadAt(pts, halves, .5f);
+            quadTo(halves, depth + 1);
+            quadTo(halves + 2, depth + 1);
+            return;
+        }
+        GVector n0 = leftNormal(u0, fRadius);
+        GVector n1 = leftNormal(u1, fRadius);
+        GVector ctrl = (n0 + n1) * (1 / (1 + c));
+        startSegment(u0);
+        fLeft.quadTo(pts[1] + ctrl, pts[2] + n1);
+        fRight.quadTo(pts[1] - ctrl, pts[2] - n1);
+        endSegment(pts[2], u1);
+    }
+
+    // A cubic whose direction barely turns is offset by moving each end and its control point
+    // along that end's normal.
+    void cubicTo(const GPoint pts[4], int depth){
+        fHasVerbs = true;
+        GVector u0 = pts[1] - pts[0];
+        if(isZero(u0)) u0 = pts[2] - pts[0];
+        if(isZero(u0)) u0 = pts[3] - pts[0];
+        GVector u3 = pts[3] - pts[2];
+        if(isZero(u3)) u3 = pts[3] - pts[1];
+        if(isZero(u3)) u3 = pts[3] - pts[0];
+        if(isZero(u0))
+            return;
+        u0 = unit(u0);
+        u3 = unit(u3);
+        if(!flatCubic(pts, u0, u3)){
+            if(depth == kMaxCurveDepth){ //only a cusp gets this far
+                lineTo(pts[3]);
+                return;
+            }
+            GPoint halves[7];
+            GPath::ChopCubicAt(pts, halves, .5f);
+            cubicTo(halves, depth + 1);
+            cubicTo(halves + 3, depth + 1);
+            return;
+        }
+        GVector n0 = leftNormal(u0, fRadius);
+        GVector n3 = leftNormal(u3, fRadius);
+        startSegment(u0);
+        fLeft.cubicTo(pts[1] + n0, pts[2] + n3, pts[3] + n3);
+        fRight.cubicTo(pts[1] - n0, pts[2] - n3, pts[3] - n3);
+        endSegment(pts[3], u3);
+    }
+
+    /**
+     *  Emit the contour stroked so far: the left side, the end cap, the right side backwards and
+     *  the start cap as one contour, or for a closed contour, each side as its own contour.
+     */
+    void finishContour(){
+        if(fSegments == 0){
+            if(fHasVerbs && fCap == GFinal::kRound)
+                fDst->addCircle(fPrevPt, fRadius);
+            else if(fHasVerbs && fCap == GFinal::kSquare)
+                fDst->addRect(GRect::LTRB(fPrevPt.x() - fRadius, fPrevPt.y() - fRadius, fPrevPt.x() + fRadius, fPrevPt.y() + fRadius));
+        }
+        else if(fSegments > 1 && fPrevPt == fFirstPt){
+            join(fFirstPt, fPrevUnit, fFirstUnit);
+            appendPath(fDst, fLeft);
+            appendReversed(fRight, true);
+        }
+        else{
+            appendPath(fDst, fLeft);
+            cap(fPrevPt, fPrevUnit);
+            appendReversed(fRight, false);
+            cap(fFirstPt, fFirstUnit * -1);
+        }
+        fLeft.reset();
+        fRight.reset();
+        fSegments = 0;
+        fHasVerbs = false;
+    }
+
+private:
+    GPath* fDst;
+    float fRadius;
+    GFinal::CapType fCap;
+    GFinal::JoinType fJoin;
+    float fMiterLimit;
+
+    // The two sides of the current contour, both running forwards.
+    GPath fLeft, fRight;
+    GPoint fFirstPt, fPrevPt;
+    GVector fFirstUnit, fPrevUnit;
+    int fSegments = 0;
+    bool fHasVerbs = false;
+
+    struct Segment {
+        GPath::Verb verb;
+        GPoint pts[4];
+    };
+    std::vector<Segment> fSegmentScratch;
+
+    static bool flatCubic(const GPoint pts[4], GVector u0, GVector u3){
+        if(dot(u0, u3) < kFlatCos)
+            return false;
+        GVector prev = u0;
+        for(int i = 1; i < 3; ++i){
+            GVector leg = pts[i + 1] - pts[i];
+            if(isZero(leg))
+                continue;
+            leg = unit(leg);
+            if(dot(prev, leg) < kFlatCos)
+                return false;
+            prev = leg;
+        }
+        return true;
+    }
+
+    // Start both sides at the first segment, or join them to the previous one.
+    void startSegment(GVector u){
+        if(fSegments == 0){
+            GVector n = leftNormal(u, fRadius);
+            fFirstUnit = u;
+            fLeft.moveTo(fPrevPt + n);
+            fRight.moveTo(fPrevPt - n);
+        }
+        else
+            join(fPrevPt, fPrevUnit, u);
+    }
+
+    void endSegment(GPoint p, GVector u){
+        fPrevPt = p;
+        fPrevUnit = u;
+        ++fSegments;
+    }
+
+    /**
+     *  Join the sides of the segments meeting at pivot, going from direction u0 to u1. The outside
+     *  of the turn gets the join; the inside goes through the pivot, leaving its overlap for the
+     *  nonzero fill to cover.
+     */
+    void join(GPoint pivot, GVector u0, GVector u1){
+        GVector n0 = leftNormal(u0, fRadius);
+        GVector n1 = leftNormal(u1, fRadius);
+        float c = dot(u0, u1);
+        if(c > kStraightCos){
+            fLeft.lineTo(pivot + n1);
+            fRight.lineTo(pivot - n1);
+            return;
+        }
+        bool leftOutside = cross(u0, u1) <= 0;
+        GPath* outer = leftOutside ? &fLeft : &fRight;
+        GPath* inner = leftOutside ? &fRight : &fLeft;
+        float s = leftOutside ? 1 : -1;
+        inner->lineTo(pivot);
+        inner->lineTo(pivot - n1 * s);
+
+        switch(fJoin){
+            case GFinal::kMiterJoin:
+                //the miter is 1/cos(half the turn) radii long, and cos(half)^2 = (1 + c) / 2
+                if(1 + c > 0 && 2 <= fMiterLimit * fMiterLimit * (1 + c))
+                    outer->lineTo(pivot + (n0 + n1) * (s / (1 + c)));
+                break;
+            case GFinal::kRoundJoin:
+                arcTo(outer, pivot, leftNormal(u0, s), leftNormal(u1, s), fRadius, u0);
+                return;
+            case GFinal::kBevelJoin:
+                break;
+        }
+        outer->lineTo(pivot + n1 * s);
+    }
+
+    // Cap the end at p, heading in direction u, from the left side (p + normal) to the right.
+    void cap(GPoint p, GVector u){
+        GVector n = leftNormal(u, fRadius);
+        switch(fCap){
+            case GFinal::kButt:
+                fDst->lineTo(p - n);
+                break;
+            case GFinal::kSquare:
+                fDst->lineTo(p + n + u * fRadius);
+                fDst->lineTo(p - n + u * fRadius);
+                fDst->lineTo(p - n);
+                break;
+            case GFinal::kRound:
+                arcTo(fDst, p, leftNormal(u, 1), leftNormal(u, -1), fRadius, u);
+                break;
+        }
+    }
+
+    // Append side to fDst backwards, as a new contour or continuing the current one.
+    void appendReversed(const GPath& side, bool newContour){
+        fSegmentScratch.clear();
+        GPath::Iter iter(side);
+        Segment seg;
+        while((seg.verb = iter.next(seg.pts)) != GPath::kDone){
+            if(seg.verb != GPath::kMove)
+                fSegmentScratch.push_back(seg);
+        }
+        if(fSegmentScratch.empty())
+            return;
+        if(newContour){
+            const Segment& last = fSegmentScratch.back();
+            fDst->moveTo(last.pts[last.verb == GPath::kLine ? 1 : last.verb == GPath::kQuad ? 2 : 3]);
+        }
+        for(int i = (int)fSegmentScratch.size() - 1; i >= 0; --i){
+            const Segment& s = fSegmentScratch[i];
+            switch(s.verb){
+                case GPath::kLine: fDst->lineTo(s.pts[0]); break;
+                case GPath::kQuad: fDst->quadTo(s.pts[1], s.pts[0]); break;
+                case GPath::kCubic: fDst->cubicTo(s.pts[2], s.pts[1], s.pts[0]); break;
+                default: break;
+            }
+        }
+    }
+};
+
+void strokePath(GPath* dst, const GPath& src, float width, GFinal::CapType cap, GFinal::JoinType join,
+                float miterLimit){
+    if(!(width > 0))
+        return;
+    //a shared copy keeps the source intact if dst is src
+    GPath source = src;
+    Stroker stroker(dst, width / 2, cap, join, miterLimit);
+    GPath::Iter iter(source);
+    GPoint pts[GPath::kMaxNextPoints];
+    GPath::Verb verb;
+    while((verb = iter.next(pts)) != GPath::kDone){
+        switch(verb){
+            case GPath::kMove: stroker.moveTo(pts[0]); break;
+            case GPath::kLine: stroker.lineTo(pts[1]); break;
+            case GPath::kQuad: stroker.quadTo(pts, 0); break;
+            case GPath::kCubic: stroker.cubicTo(pts, 0); break;
+            default: break;
+        }
+    }
+    stroker.finishContour();
+}
@@ -0,0 +1,20 @@
+#ifndef GStroker_DEFINED
+#define GStroker_DEFINED
+
+#include "include/GFinal.h"
+#include "include/GPath.h"
+
+/**
+ *  Append to dst the outline of src stroked with the given width, as contours to be filled with
+ *  the nonzero rule. Each contour of src becomes one contour of dst (two if it is closed, one
+ *  for each side), whatever mix of lines, quads and cubics it has.
+ *
+ *  A contour whose last point returns to its first is stroked closed, with a join where it meets
+ *  itself; any other contour gets caps at both ends. Miter joins longer than miterLimit times
+ *  half the width fall back to bevels. A contour with no length draws a dot for round and square
+ *  caps, and nothing for butt caps.
+ */
+void strokePath(GPath* dst, const GPath& src, float width, GFinal::CapType, GFinal::JoinType,
+                float miterLimit);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef GTexture_DEFINED
+#define GTexture_DEFINED
+
+#include "include/GBitmap.h"
+#include "include/GPoint.h"
+
+// Blend two premul pixels, w/256 of the way from a to b. Two channels are scaled per multiply.
+static inline GPixel lerpPixel(GPixel a, GPixel b, unsigned w){
+    uint32_t rb = ((a & 0x00FF00FF) * (256 - w) + (b & 0x00FF00FF) * w) >> 8;
+    uint32_t ag = ((a >> 8) & 0x00FF00FF) * (256 - w) + ((b >> 8) & 0x00FF00FF) * w;
+    return (rb & 0x00FF00FF) | (ag & 0xFF00FF00);
+}
+
+// The texel containing (u, v), clamped to the texture.
+static inline GPixel sampleNearest(const GBitmap& texture, float u, float v){
+    int x = (int)std::max(0.f, std::min(floorf(u), (float)(texture.width() - 1)));
+    int y = (int)std::max(0.f, std::min(floorf(v), (float)(texture.height() - 1)));
+    return *texture.getAddr(x, y);
+}
+
+// The 4 texels whose centers surround (u, v), weighted by distance and clamped to the texture.
+static inline GPixel sampleBilinear(const GBitmap& texture, float u, float v){
+    float maxX = texture.width() - 1;
+    float maxY = texture.height() - 1;
+    u = std::max(0.f, std::min(u - .5f, maxX));
+    v = std::max(0.f, std::min(v - .5f, maxY));
+    int x0 = (int)u;
+    int y0 = (int)v;
+    int x1 = std::min(x0 + 1, (int)maxX);
+    int y1 = std::min(y0 + 1, (int)maxY);
+    unsigned wx = (unsigned)((u - x0) * 256 + .5f);
+    unsigned wy = (unsigned)((v - y0) * 256 + .5f);
+
+    GPixel top = lerpPixel(*texture.getAddr(x0, y0), *texture.getAddr(x1, y0), wx);
+    GPixel bottom = lerpPixel(*texture.getAddr(x0, y1), *texture.getAddr(x1, y1), wx);
+    return lerpPixel(top, bottom, wy);
+}
+
+typedef void (*TextureRowProc)(const GBitmap& texture, GPoint uv, GPoint duv, float q, float dq, int count, GPixel row[]);
+
+/**
+ *  Sample count pixels of a device row. Pixel i samples the texture at (uv + i*duv) / (q + i*dq)
+ *  when perspective, or at uv + i*duv otherwise (q and dq are then ignored).
+ */
+template <bool bilinear, bool perspective> void sampleTextureRow(const GBitmap& texture, GPoint uv, GPoint duv, float q, float dq, int count, GPixel row[]){
+    for(int i = 0; i < count; ++i){
+        float u = uv.x();
+        float v = uv.y();
+        if(perspective){
+            float w = 1 / q;
+            u *= w;
+            v *= w;
+            q += dq;
+        }
+        row[i] = bilinear ? sampleBilinear(texture, u, v) : sampleNearest(texture, u, v);
+        uv += duv;
+    }
+}
+
+static inline TextureRowProc textureRowProc(bool bilinear, bool perspective){
+    static const TextureRowProc procs[2][2] = {
+        { sampleTextureRow<false, false>, sampleTextureRow<false, true> },
+        { sampleTextureRow<true, false>,  sampleTextureRow<true, true>  },
+    };
+    return procs[bilinear][perspective];
+}
+
+#endif
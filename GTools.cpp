@@ -1,23 +1,26 @@
+#include "include/GPath.h"
 #include "GTools.h"
 
-static void createEdge(GPoint p0, GPoint p1, std::vector<edge*>& edges, int winding){
+static void createEdge(GPoint p0, GPoint p1, std::vector<edge>& edges, int winding){
     if(p0.y() > p1.y()){ //swap points if p0 is below p1
         std::swap(p0, p1);
     }
-    edge* newEdge = (edge*)malloc(sizeof(edge));
-    newEdge->top = GRoundToInt(p0.y());
-    newEdge->bottom = GRoundToInt(p1.y());
-    if(newEdge->top == newEdge->bottom){
+    edge newEdge;
+    newEdge.top = GRoundToInt(p0.y());
+    newEdge.bottom = GRoundToInt(p1.y());
+    if(newEdge.top == newEdge.bottom){
         return;
     }
-    newEdge->m = ((p1.x() - p0.x()) / (p1.y() - p0.y()));
-    newEdge->curX = p0.x() + newEdge->m * (newEdge->top - p0.y() + .5f); //x at pixel center
-    newEdge->winding = winding;
+    newEdge.m = ((p1.x() - p0.x()) / (p1.y() - p0.y()));
+    newEdge.curX = p0.x() + newEdge.m * (newEdge.top - p0.y() + .5f); //x at pixel center
+    newEdge.winding = winding;
+    newEdge.segments = 0;
+    newEdge.segBottom = newEdge.bottom;
     
     edges.push_back(newEdge);
 }
 
-void clip(GPoint p0, GPoint p1, GRect canvas, std::vector<edge*>& edges){
+void clip(GPoint p0, GPoint p1, GRect canvas, std::vector<edge>& edges){
     int winding = -1;
     if(p0.y() == p1.y()){ //if the line is horizontal
         return;
@@ -78,6 +81,170 @@ void clip(GPoint p0, GPoint p1, GRect canvas, std::vector<edge*>& edges){
     createEdge(p0, p1, edges, winding);
 }
 
+// How far, in device pixels, a flattened curve may stray from the true curve.
+static const float kCurveTolerance = .25f;
+
+/**
+ *  Add one edge for a quadratic or cubic (count 3 or 4 points) that is monotonic in y, stepped
+ *  as k forward-differenced segments. The curve keeps its full extent in x, so spans must be
+ *  pinned to the canvas; in y it is cut to the canvas here.
+ */
+static void createCurveEdge(const GPoint src[], int count, int k, GRect canvas, std::vector<edge>& edges){
+    //step the curve from its upper end, so rows are visited top down
+    GPoint pts[4];
+    int winding = -1;
+    for(int i = 0; i < count; ++i)
+        pts[i] = src[i];
+    if(pts[0].y() > pts[count-1].y()){
+        std::reverse(pts, pts + count);
+        winding = 1;
+    }
+
+    edge newEdge;
+    float h = 1.0f/k;
+    if(count == 3){
+        GPoint a = pts[0] - 2*pts[1] + pts[2];
+        GPoint b = 2*(pts[1] - pts[0]);
+        newEdge.d1 = a*(h*h) + b*h;
+        newEdge.d2 = a*(2*h*h);
+        newEdge.d3 = {0, 0};
+    }
+    else{
+        GPoint a = (pts[3] - pts[0]) + 3*(pts[1] - pts[2]);
+        GPoint b = 3*(pts[0] - 2*pts[1] + pts[2]);
+        GPoint c = 3*(pts[1] - pts[0]);
+        newEdge.d1 = a*(h*h*h) + b*(h*h) + c*h;
+        newEdge.d2 = a*(6*h*h*h) + b*(2*h*h);
+        newEdge.d3 = a*(6*h*h*h);
+    }
+
+    newEdge.top = GRoundToInt(pts[0].y());
+    newEdge.bottom = std::min(GRoundToInt(pts[count-1].y()), (int)canvas.bottom());
+    newEdge.winding = winding;
+    newEdge.segments = k;
+    newEdge.segBottom = newEdge.top;
+    newEdge.pt = pts[0];
+    newEdge.last = pts[count-1];
+    if(newEdge.top >= newEdge.bottom || !newEdge.nextSegment())
+        return;
+
+    int top = (int)canvas.top();
+    if(newEdge.top < top){
+        if(newEdge.bottom <= top)
+            return;
+        newEdge.skipTo(top);
+    }
+    edges.push_back(newEdge);
+}
+
+// True if the control points, and so the whole curve, lie on the far side of one of the canvas's edges.
+static bool outsideCanvas(const GPoint pts[], int count, GRect canvas){
+    float left = pts[0].x(), right = left, top = pts[0].y(), bottom = top;
+    for(int i = 1; i < count; ++i){
+        left = std::min(left, pts[i].x());
+        right = std::max(right, pts[i].x());
+        top = std::min(top, pts[i].y());
+        bottom = std::max(bottom, pts[i].y());
+    }
+    return right <= canvas.left() || left >= canvas.right() || bottom <= canvas.top() || top >= canvas.bottom();
+}
+
+// A quadratic that is monotonic in y becomes a single curve edge.
+static void clipMonoQuad(const GPoint pts[3], GRect canvas, std::vector<edge>& edges){
+    //off the canvas only the curve's winding matters, and its chord winds the same way
+    if(outsideCanvas(pts, 3, canvas)){
+        clip(pts[0], pts[2], canvas, edges);
+        return;
+    }
+
+    //with k segments the error is at most |A - 2B + C| / (4k^2)
+    GPoint a = pts[0] - 2*pts[1] + pts[2];
+    int k = std::max(1, GCeilToInt(sqrtf(a.length() / (4 * kCurveTolerance))));
+    createCurveEdge(pts, 3, k, canvas, edges);
+}
+
+// A cubic that is monotonic in y becomes a single curve edge.
+static void clipMonoCubic(const GPoint pts[4], GRect canvas, std::vector<edge>& edges){
+    if(outsideCanvas(pts, 4, canvas)){
+        clip(pts[0], pts[3], canvas, edges);
+        return;
+    }
+
+    //with k segments the error is at most 3/4 * max(|A - 2B + C|, |B - 2C + D|) / k^2
+    GPoint e0 = pts[0] - 2*pts[1] + pts[2];
+    GPoint e1 = pts[1] - 2*pts[2] + pts[3];
+    GPoint e = {std::max(fabsf(e0.x()), fabsf(e1.x())), std::max(fabsf(e0.y()), fabsf(e1.y()))};
+    int k = std::max(1, GCeilToInt(sqrtf(e.length() * .75f / kCurveTolerance)));
+    createCurveEdge(pts, 4, k, canvas, edges);
+}
+
+/**
+ *  Add edges for a quadratic. It is cut at its extreme in y, if it has one, so that each piece
+ *  is monotonic and can be stepped as a single edge.
+ */
+void clipQuad(const GPoint pts[3], GRect canvas, std::vector<edge>& edges){
+    float denom = pts[0].y() - 2*pts[1].y() + pts[2].y();
+    float t = denom != 0 ? (pts[0].y() - pts[1].y()) / denom : 0;
+    if(t <= 0 || t >= 1){
+        clipMonoQuad(pts, canvas, edges);
+        return;
+    }
+
+    GPoint chopped[5];
+    GPath::ChopQuadAt(pts, chopped, t);
+    chopped[1].fY = chopped[3].fY = chopped[2].y(); //flatten the extreme so each half stays monotonic
+    clipMonoQuad(chopped, canvas, edges);
+    clipMonoQuad(chopped + 2, canvas, edges);
+}
+
+/**
+ *  Add edges for a cubic, cut at its (up to two) extremes in y so that each piece is monotonic
+ *  and can be stepped as a single edge.
+ */
+void clipCubic(const GPoint pts[4], GRect canvas, std::vector<edge>& edges){
+    //dy/dt is proportional to a*t^2 + 2*b*t + c
+    float a = pts[3].y() - 3*pts[2].y() + 3*pts[1].y() - pts[0].y();
+    float b = pts[2].y() - 2*pts[1].y() + pts[0].y();
+    float c = pts[1].y() - pts[0].y();
+
+    //the roots are q/a and c/q, which stays accurate when a or c is near 0
+    float roots[2];
+    int count = 0;
+    float discriminant = b*b - a*c;
+    if(discriminant >= 0){
+        float q = b >= 0 ? -(b + sqrtf(discriminant)) : -(b - sqrtf(discriminant));
+        if(a != 0)
+            roots[count++] = q / a;
+        if(q != 0)
+            roots[count++] = c / q;
+    }
+
+    //keep the roots strictly inside (0, 1), in order
+    float ts[2];
+    int n = 0;
+    for(int i = 0; i < count; ++i){
+        if(roots[i] > 0 && roots[i] < 1)
+            ts[n++] = roots[i];
+    }
+    if(n == 2 && ts[0] > ts[1])
+        std::swap(ts[0], ts[1]);
+    if(n == 2 && ts[0] == ts[1])
+        n = 1;
+
+    GPoint piece[4] = {pts[0], pts[1], pts[2], pts[3]};
+    float start = 0;
+    for(int i = 0; i < n; ++i){
+        GPoint chopped[7];
+        GPath::ChopCubicAt(piece, chopped, (ts[i] - start) / (1 - start));
+        chopped[2].fY = chopped[4].fY = chopped[3].y(); //flatten the extreme so each half stays monotonic
+        clipMonoCubic(chopped, canvas, edges);
+        for(int j = 0; j < 4; ++j)
+            piece[j] = chopped[3 + j];
+        start = ts[i];
+    }
+    clipMonoCubic(piece, canvas, edges);
+}
+
 bool edge_sorter(edge* const& e1, edge* const& e2){
     if(e1->top == e2->top)
         return e1->curX < e2->curX;
@@ -1,22 +1,103 @@
+#ifndef GTools_DEFINED
+#define GTools_DEFINED
+
 #include "include/GPixel.h"
 #include "include/GColor.h"
 #include "include/GPoint.h"
 #include "include/GRect.h"
+#include "include/GShader.h"
 
 #include "GEdge.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 static inline unsigned int div255(unsigned int x){
     x += 128;
     return (x + (x >> 8)) >> 8;
 }
 
+// Scale each component of a premul pixel by s/255, rounding like div255().
+static inline GPixel scalePixel(GPixel p, unsigned s){
+    uint32_t rb = (p & 0x00FF00FF) * s + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    uint32_t ag = ((p >> 8) & 0x00FF00FF) * s + 0x00800080;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    return rb | ag;
+}
+
+// Component-wise product of two premul pixels.
+static inline GPixel multiplyPixel(GPixel p0, GPixel p1){
+    return GPixel_PackARGB(
+        div255(GPixel_GetA(p0) * GPixel_GetA(p1)),
+        div255(GPixel_GetR(p0) * GPixel_GetR(p1)),
+        div255(GPixel_GetG(p0) * GPixel_GetG(p1)),
+        div255(GPixel_GetB(p0) * GPixel_GetB(p1))
+    );
+}
+
 static inline GPixel makePixel(const GColor& color){
     if(color.a == 1)
         return GPixel_PackARGB(255, GRoundToInt(color.r*255), GRoundToInt(color.g*255), GRoundToInt(color.b*255));
     return GPixel_PackARGB(GRoundToInt(color.a*255), GRoundToInt(color.r*color.a*255), GRoundToInt(color.g*color.a*255), GRoundToInt(color.b*color.a*255));
 }
 
-void clip(GPoint, GPoint, GRect, std::vector<edge*>&);
+#if defined(__SSE2__)
+// Same as makePixel(), for an unpremul color held as {r, g, b, a} in a vector.
+static inline GPixel makePixel(__m128 rgba){
+    const __m128 alphaLane = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    __m128 bgra = _mm_shuffle_ps(rgba, rgba, _MM_SHUFFLE(3, 0, 1, 2));
+    __m128 a = _mm_shuffle_ps(bgra, bgra, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 scale = _mm_or_ps(_mm_andnot_ps(alphaLane, a), _mm_and_ps(alphaLane, _mm_set1_ps(1)));
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(bgra, scale), _mm_set1_ps(255)), _mm_set1_ps(.5f));
+    __m128i c16 = _mm_packs_epi32(_mm_cvttps_epi32(c), _mm_setzero_si128());
+    return _mm_cvtsi128_si32(_mm_packus_epi16(c16, _mm_setzero_si128()));
+}
+#endif
+
+/**
+ *  Fill row[0...count-1] with an unpremul color that starts at color and changes by delta per
+ *  pixel (e.g. vertex colors interpolated across a span), packed into premul pixels.
+ */
+static inline void interpolateColorRow(GPixel row[], int count, const GColor& color, const GColor& delta){
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 d = _mm_loadu_ps(&delta.r);
+    __m128 c = _mm_loadu_ps(&color.r);
+    for(int i = 0; i < count; ++i){
+        row[i] = makePixel(_mm_min_ps(_mm_max_ps(c, zero), one));
+        c = _mm_add_ps(c, d);
+    }
+#else
+    GColor c = color;
+    for(int i = 0; i < count; ++i){
+        row[i] = makePixel(c.pinToUnit());
+        c += delta;
+    }
+#endif
+}
+
+// Maps a gradient parameter into [0, 1] for the given tile mode. Each mode is its own
+// specialization so row loops can be instantiated per mode without branching per pixel.
+template <GShader::TileMode mode> static inline float tileUnit(float t);
+template <> inline float tileUnit<GShader::kClamp>(float t){
+    return GPinToUnit(t);
+}
+template <> inline float tileUnit<GShader::kRepeat>(float t){
+    return t - floorf(t);
+}
+template <> inline float tileUnit<GShader::kMirror>(float t){
+    float half = t * .5f;
+    return 1 - fabsf(2 * (half - floorf(half)) - 1);
+}
+
+void clip(GPoint, GPoint, GRect, std::vector<edge>&);
+void clipQuad(const GPoint pts[3], GRect, std::vector<edge>&);
+void clipCubic(const GPoint pts[4], GRect, std::vector<edge>&);
 bool edge_sorter(edge* const& e1, edge* const& e2);
 bool edge_sorter2(edge* const& e1, edge* const& e2);
+
+#endif
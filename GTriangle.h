@@ -0,0 +1,78 @@
+#ifndef GTriangle_DEFINED
+#define GTriangle_DEFINED
+
+#include "include/GPoint.h"
+#include "include/GRect.h"
+
+/**
+ *  Scan converts a device-space triangle, calling blitter(y, L, R) for each row it covers inside
+ *  clip, with L < R. A pixel is covered when its center is inside by the same rule as the rest
+ *  of the canvas (center > min edge && center <= max edge), so triangles that share an edge
+ *  never touch the same pixel twice. Each row's span depends only on the triangle and the row,
+ *  never on clip, so a triangle drawn in pieces matches one drawn whole. Nothing is allocated.
+ */
+template <typename Blitter> void scanTriangle(const GPoint pts[3], const GIRect& clip, Blitter&& blitter){
+    const GPoint* p0 = &pts[0];
+    const GPoint* p1 = &pts[1];
+    const GPoint* p2 = &pts[2];
+    if(p0->y() > p1->y()) std::swap(p0, p1);
+    if(p1->y() > p2->y()) std::swap(p1, p2);
+    if(p0->y() > p1->y()) std::swap(p0, p1);
+
+    int top = std::max(GRoundToInt(p0->y()), clip.top());
+    int bottom = std::min(GRoundToInt(p2->y()), clip.bottom());
+    if(top >= bottom)
+        return;
+
+    //spans are pinned to the clip, so a triangle entirely to one side draws nothing
+    float minX = std::min(p0->x(), std::min(p1->x(), p2->x()));
+    float maxX = std::max(p0->x(), std::max(p1->x(), p2->x()));
+    if(GRoundToInt(maxX) <= clip.left() || GRoundToInt(minX) >= clip.right())
+        return;
+
+    float longSlope = (p2->x() - p0->x()) / (p2->y() - p0->y());
+    int mid = GRoundToInt(p1->y());
+
+    //rows [y0, y1) lie between the long edge and the short edge a..b
+    auto scan = [&](int y0, int y1, const GPoint& a, const GPoint& b){
+        if(y0 >= y1)
+            return;
+        float slope = (b.x() - a.x()) / (b.y() - a.y());
+        for(int y = y0; y < y1; ++y){
+            //x is evaluated from the edge's start each row rather than accumulated, so a row's span
+            //doesn't depend on which row scanning began at (e.g. when a band clips the top)
+            int L = GRoundToInt(a.x() + (y + .5f - a.y()) * slope);
+            int R = GRoundToInt(p0->x() + (y + .5f - p0->y()) * longSlope);
+            if(L > R)
+                std::swap(L, R);
+            L = std::max(L, clip.left());
+            R = std::min(R, clip.right());
+            if(L < R)
+                blitter(y, L, R);
+        }
+    };
+    scan(top, std::min(mid, bottom), *p0, *p1);
+    scan(std::max(mid, top), bottom, *p1, *p2);
+}
+
+/**
+ *  Write the triangles of a divisions x divisions grid of vertices (stored row by row) into
+ *  indices, which must hold (divisions-1)^2 * 6 ints. Each cell is split on its top-right to
+ *  bottom-left diagonal, as drawQuad() documents, so every tesselated patch is cut the same way.
+ */
+inline void gridIndices(int divisions, int indices[]){
+    for(int i = 0; i < divisions-1; ++i){
+        for(int j = 0; j < divisions-1; ++j){
+            int topLeft = i * divisions + j;
+            int bottomLeft = topLeft + divisions;
+            *indices++ = topLeft;
+            *indices++ = topLeft + 1;
+            *indices++ = bottomLeft;
+            *indices++ = topLeft + 1;
+            *indices++ = bottomLeft + 1;
+            *indices++ = bottomLeft;
+        }
+    }
+}
+
+#endif
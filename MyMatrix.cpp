@@ -1,20 +1,29 @@
 #include "include/GMatrix.h"
 
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 GMatrix::GMatrix() {
         fMat[0] = fMat[4] = 1;
         fMat[1] = fMat[2] = fMat[3] = fMat[5] = 0;
+        fTypeMask = kIdentity_Mask;
     }  // initialize to identity
 
 GMatrix GMatrix::Translate(float tx, float ty){
     GMatrix m;
     m.fMat[2] = tx;
     m.fMat[5] = ty;
+    m.fTypeMask = m.computeTypeMask();
     return m;
 }
 GMatrix GMatrix::Scale(float sx, float sy){
     GMatrix m;
     m.fMat[0] = sx;
     m.fMat[4] = sy;
+    m.fTypeMask = m.computeTypeMask();
     return m;
 }
 GMatrix GMatrix::Rotate(float radians){
@@ -23,6 +32,7 @@ GMatrix GMatrix::Rotate(float radians){
     m.fMat[1] = -sin(radians);
     m.fMat[3] = sin(radians);
     m.fMat[4] = cos(radians);
+    m.fTypeMask = m.computeTypeMask();
     return m;
 }
 
@@ -37,6 +47,7 @@ GMatrix GMatrix::Concat(const GMatrix& a, const GMatrix& b){
     m.fMat[3] = a.fMat[3] * b.fMat[0] + a.fMat[4] * b.fMat[3];
     m.fMat[4] = a.fMat[3] * b.fMat[1] + a.fMat[4] * b.fMat[4];
     m.fMat[5] = a.fMat[3] * b.fMat[2] + a.fMat[4] * b.fMat[5] + a.fMat[5];
+    m.fTypeMask = m.computeTypeMask();
     return m;
 }
 
@@ -60,6 +71,7 @@ bool GMatrix::invert(GMatrix* inverse) const{
     m.fMat[3] = -fMat[3] * invDet;
     m.fMat[4] = fMat[0] * invDet;
     m.fMat[5] = (fMat[3] * fMat[2] - fMat[0] * fMat[5]) * invDet;
+    m.fTypeMask = m.computeTypeMask();
     *inverse = m;
     return true;
 }
@@ -79,9 +91,47 @@ bool GMatrix::invert(GMatrix* inverse) const{
      *  matrix.mapPoints(pts, pts, count);
      */
 void GMatrix::mapPoints(GPoint dst[], const GPoint src[], int count) const{
-    for(int i = 0; i < count; ++i){
+    //most matrices only translate or scale, so each type gets its own loop with no wasted math
+    unsigned type = getType();
+    if(type == kIdentity_Mask){
+        if(dst != src)
+            memcpy(dst, src, count * sizeof(GPoint));
+        return;
+    }
+
+    int i = 0;
+#if defined(__SSE2__)
+    //two points per vector, as {x0, y0, x1, y1}
+    const __m128 scale = _mm_setr_ps(fMat[0], fMat[4], fMat[0], fMat[4]);
+    const __m128 skew = _mm_setr_ps(fMat[1], fMat[3], fMat[1], fMat[3]);
+    const __m128 trans = _mm_setr_ps(fMat[2], fMat[5], fMat[2], fMat[5]);
+    if(type == kTranslate_Mask){
+        for(; i + 2 <= count; i += 2)
+            _mm_storeu_ps(&dst[i].fX, _mm_add_ps(_mm_loadu_ps(&src[i].fX), trans));
+    }
+    else if(!(type & kAffine_Mask)){
+        for(; i + 2 <= count; i += 2)
+            _mm_storeu_ps(&dst[i].fX, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&src[i].fX), scale), trans));
+    }
+    else{
+        for(; i + 2 <= count; i += 2){
+            __m128 p = _mm_loadu_ps(&src[i].fX);
+            __m128 swapped = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 3, 0, 1));
+            _mm_storeu_ps(&dst[i].fX, _mm_add_ps(_mm_add_ps(_mm_mul_ps(p, scale), _mm_mul_ps(swapped, skew)), trans));
+        }
+    }
+#endif
+    if(!(type & kAffine_Mask)){
+        for(; i < count; ++i){
+            GPoint p = src[i];
+            dst[i].fX = fMat[0] * p.x() + fMat[2];
+            dst[i].fY = fMat[4] * p.y() + fMat[5];
+        }
+        return;
+    }
+    for(; i < count; ++i){
         GPoint p = src[i];
         dst[i].fX = fMat[0] * p.x() + fMat[1] * p.y() + fMat[2];
         dst[i].fY = fMat[3] * p.x() + fMat[4] * p.y() + fMat[5];
     }
-}
\ No newline at end of file
+}
@@ -15,35 +15,149 @@ void GPath::addRect(const GRect& rect, Direction dir){
     }
 }
 
-GRect GPath::bounds() const {
+static GRect computeBounds(const std::vector<GPoint>& pts){
     GRect bounds = GRect::WH(0, 0);
-    if(fPts.size() == 0){
+    if(pts.size() == 0){
         return bounds;
     }
-    bounds.fLeft = fPts[0].fX;
-    bounds.fTop = fPts[0].fY;
-    bounds.fRight = fPts[0].fX;
-    bounds.fBottom = fPts[0].fY;
-    for(int i = 1; i < fPts.size(); i++){
-        if(fPts[i].fX < bounds.fLeft){
-            bounds.fLeft = fPts[i].fX;
+    bounds.fLeft = pts[0].fX;
+    bounds.fTop = pts[0].fY;
+    bounds.fRight = pts[0].fX;
+    bounds.fBottom = pts[0].fY;
+    for(int i = 1; i < pts.size(); i++){
+        if(pts[i].fX < bounds.fLeft){
+            bounds.fLeft = pts[i].fX;
         }
-        if(fPts[i].fX > bounds.fRight){
-            bounds.fRight = fPts[i].fX;
+        if(pts[i].fX > bounds.fRight){
+            bounds.fRight = pts[i].fX;
         }
-        if(fPts[i].fY < bounds.fTop){
-            bounds.fTop = fPts[i].fY;
+        if(pts[i].fY < bounds.fTop){
+            bounds.fTop = pts[i].fY;
         }
-        if(fPts[i].fY > bounds.fBottom){
-            bounds.fBottom = fPts[i].fY;
+        if(pts[i].fY > bounds.fBottom){
+            bounds.fBottom = pts[i].fY;
         }
     }
     return bounds;
 }
 
+static float cross(GPoint a, GPoint b){
+    return a.x() * b.y() - a.y() * b.x();
+}
+
+/**
+ *  Classify a single contour of lines. It is convex if every turn is the same way and it
+ *  changes direction in x and in y at most twice each (which rules out stars, whose turns
+ *  all agree but which wind more than once).
+ */
+static GPath::Shape polygonShape(const GPoint pts[], int count){
+    if(count == 4){
+        bool horizontalFirst = pts[0].y() == pts[1].y() && pts[1].x() == pts[2].x() && pts[2].y() == pts[3].y() && pts[3].x() == pts[0].x();
+        bool verticalFirst = pts[0].x() == pts[1].x() && pts[1].y() == pts[2].y() && pts[2].x() == pts[3].x() && pts[3].y() == pts[0].y();
+        if((horizontalFirst || verticalFirst) && pts[0].x() != pts[2].x() && pts[0].y() != pts[2].y())
+            return GPath::kRect_Shape;
+    }
+
+    int turn = 0;
+    int xChanges = 0, yChanges = 0;
+    GPoint lastEdge = {0, 0};
+    int lastX = 0, lastY = 0;
+    for(int i = 0; i <= count; ++i){
+        GPoint e = pts[(i + 1) % count] - pts[i % count];
+        if(e.x() == 0 && e.y() == 0)
+            continue;
+        //i == count revisits the first edge, to check the turn back onto it
+        if(lastEdge.x() != 0 || lastEdge.y() != 0){
+            float c = cross(lastEdge, e);
+            int sign = c > 0 ? 1 : c < 0 ? -1 : 0;
+            if(sign != 0){
+                if(turn != 0 && sign != turn)
+                    return GPath::kGeneral_Shape;
+                turn = sign;
+            }
+        }
+        if(i < count){
+            int sx = e.x() > 0 ? 1 : e.x() < 0 ? -1 : 0;
+            int sy = e.y() > 0 ? 1 : e.y() < 0 ? -1 : 0;
+            if(sx != 0){
+                xChanges += lastX != 0 && sx != lastX;
+                lastX = sx;
+            }
+            if(sy != 0){
+                yChanges += lastY != 0 && sy != lastY;
+                lastY = sy;
+            }
+        }
+        lastEdge = e;
+    }
+    return turn != 0 && xChanges <= 2 && yChanges <= 2 ? GPath::kConvex_Shape : GPath::kGeneral_Shape;
+}
+
+static GPath::Shape computeShape(const std::vector<GPoint>& pts, const std::vector<GPath::Verb>& vbs, bool isCircle){
+    if(isCircle)
+        return GPath::kOval_Shape;
+    if(pts.size() < 3 || vbs[0] != GPath::kMove)
+        return GPath::kGeneral_Shape;
+    for(size_t i = 1; i < vbs.size(); ++i){
+        if(vbs[i] != GPath::kLine)
+            return GPath::kGeneral_Shape;
+    }
+
+    //the contour closes itself, so a repeated first point adds nothing
+    int count = (int)pts.size();
+    if(pts[count - 1] == pts[0])
+        --count;
+    if(count < 3)
+        return GPath::kGeneral_Shape;
+    return polygonShape(pts.data(), count);
+}
+
+void GPath::analyze(GRect* bounds, Shape* shape) const {
+    Storage& storage = *fStorage;
+    if(storage.fAnalysis.load(std::memory_order_acquire) == 2){
+        *bounds = storage.fBounds;
+        *shape = storage.fShape;
+        return;
+    }
+
+    *bounds = computeBounds(storage.fPts);
+    *shape = computeShape(storage.fPts, storage.fVbs, storage.fIsCircle);
+
+    //copies sharing the storage may get here together; only the first stores its results
+    int expected = 0;
+    if(storage.fAnalysis.compare_exchange_strong(expected, 1)){
+        storage.fBounds = *bounds;
+        storage.fShape = *shape;
+        storage.fAnalysis.store(2, std::memory_order_release);
+    }
+}
+
+GRect GPath::bounds() const {
+    GRect bounds;
+    Shape shape;
+    analyze(&bounds, &shape);
+    return bounds;
+}
+
+GPath::Shape GPath::shape() const {
+    GRect bounds;
+    Shape shape;
+    analyze(&bounds, &shape);
+    return shape;
+}
+
 void GPath::transform(const GMatrix& matrix){
-    for(int i = 0; i < fPts.size(); ++i)
-        matrix.mapPoints(&fPts[i], 1);
+    //shared points are mapped straight into new storage, rather than copied and then mapped
+    if(fStorage.use_count() > 1){
+        std::shared_ptr<Storage> mapped = std::make_shared<Storage>();
+        mapped->fPts.resize(fStorage->fPts.size());
+        matrix.mapPoints(mapped->fPts.data(), fStorage->fPts.data(), countPoints());
+        mapped->fVbs = fStorage->fVbs;
+        fStorage = mapped;
+        return;
+    }
+    Storage& storage = edit();
+    matrix.mapPoints(storage.fPts.data(), storage.fPts.data(), countPoints());
 }
 
 void GPath::addPolygon(const GPoint pts[], int count){
@@ -79,6 +193,7 @@ void GPath::addCircle(GPoint center, float radius, GPath::Direction d){
     GMatrix transform = GMatrix::Translate(center.fX, center.fY) * GMatrix::Scale(radius, radius);
     transform.mapPoints(points, 13);
 
+    bool wasEmpty = countPoints() == 0;
     moveTo(points[0]);
     if(d == kCCW_Direction){ //WHYYYY??????
         for(int i = 1; i < 13; i+=3)
@@ -88,6 +203,7 @@ void GPath::addCircle(GPoint center, float radius, GPath::Direction d){
         for(int i = 11; i > 0; i-=3)
             cubicTo(points[i], points[i-1], points[i-2]);
     }
+    fStorage->fIsCircle = wasEmpty;
 }
 
 
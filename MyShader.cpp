@@ -13,9 +13,13 @@ public:
 
     // The draw calls in GCanvas must call this with the CTM before any calls to shadeSpan().
     bool setContext(const GMatrix& ctm) override {
-        bool success = ctm.invert(&fInv);
-        fInv = fLocalInverse * fInv;
-        return success;
+        GMatrix inverse;
+        return ctm.invert(&inverse) && setContext(ctm, inverse);
+    }
+
+    bool setContext(const GMatrix& ctm, const GMatrix& inverse) override {
+        fInv = fLocalInverse * inverse;
+        return true;
     }
 
     /**
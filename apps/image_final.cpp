@@ -13,6 +13,7 @@
 #include "../include/GPoint.h"
 #include "../include/GRandom.h"
 #include "../include/GRect.h"
+#include "../GPathMeasure.h"
 #include <string>
 
 static GPoint center(const GRect& r) {
@@ -176,3 +177,408 @@ static void final_coons(GCanvas* canvas) {
     const int N = 8;
     GCreateFinal()->drawQuadraticCoons(canvas, pts, tex, N, paint);
 }
+
+////////
+
+// Draw one hairline on a clear bitmap and check that it covers exactly the expected pixels.
+static void check_hairline(const GPoint pts[2], const int expected[][2], int count) {
+    GPixel pixels[16 * 16];
+    GBitmap bm(16, 16, 16 * sizeof(GPixel), pixels, false);
+    auto canvas = GCreateCanvas(bm);
+    canvas->clear({0, 0, 0, 0});
+    canvas->drawHairlines(pts, 2, GPaint({0, 0, 0, 1}));
+
+    int drawn = 0;
+    visit_pixels(bm, [&](int, int, GPixel* p) {
+        drawn += *p != 0;
+    });
+    assert(drawn == count);
+    for (int i = 0; i < count; ++i) {
+        assert(*bm.getAddr(expected[i][0], expected[i][1]) == GPixel_PackARGB(255, 0, 0, 0));
+    }
+}
+
+// Answers worked out by hand: one pixel per column (or row) whose center the line spans, in the
+// row (or column) the line crosses that center in.
+static void check_hairline_answers() {
+    // horizontal, centers 2.5 ... 9.5 in row 5
+    const GPoint horz[] = { {2, 5.5f}, {10, 5.5f} };
+    const int horzPixels[][2] = { {2,5}, {3,5}, {4,5}, {5,5}, {6,5}, {7,5}, {8,5}, {9,5} };
+    check_hairline(horz, horzPixels, GARRAY_COUNT(horzPixels));
+
+    // vertical, drawn upwards, centers 2.5 ... 9.5 in column 12
+    const GPoint vert[] = { {12.5f, 10}, {12.5f, 2} };
+    const int vertPixels[][2] = { {12,2}, {12,3}, {12,4}, {12,5}, {12,6}, {12,7}, {12,8}, {12,9} };
+    check_hairline(vert, vertPixels, GARRAY_COUNT(vertPixels));
+
+    // 45 degrees, a fifth of a pixel down: at x = 1.5 ... 8.5 it's at y = 1.7 ... 8.7
+    const GPoint diag[] = { {1, 1.2f}, {9, 9.2f} };
+    const int diagPixels[][2] = { {1,1}, {2,2}, {3,3}, {4,4}, {5,5}, {6,6}, {7,7}, {8,8} };
+    check_hairline(diag, diagPixels, GARRAY_COUNT(diagPixels));
+
+    // sub-pixel ends only span the centers 3.5, 4.5 and 5.5
+    const GPoint inside[] = { {2.7f, 3.4f}, {6.4f, 3.6f} };
+    const int insidePixels[][2] = { {3,3}, {4,3}, {5,3} };
+    check_hairline(inside, insidePixels, GARRAY_COUNT(insidePixels));
+
+    // too short to span any center draws nothing
+    const GPoint none[] = { {4.6f, 7.2f}, {5.4f, 7.4f} };
+    check_hairline(none, nullptr, 0);
+}
+
+static void final_hairlines(GCanvas* canvas) {
+    check_hairline_answers();
+
+    const GColor colors[] = { {1,0,0,1}, {0,1,0,1}, {0,0,1,1} };
+    auto sh = GCreateLinearGradient({0, 0}, {512, 512}, colors, GARRAY_COUNT(colors),
+                                    GShader::kClamp);
+    GPaint paint(sh.get());
+
+    // grid lines on whole pixel edges, under a gradient that's the same on every row
+    auto horzSh = GCreateLinearGradient({16, 0}, {256, 0}, colors, GARRAY_COUNT(colors),
+                                        GShader::kClamp);
+    GPaint gridPaint(horzSh.get());
+    for (int i = 0; i <= 16; ++i) {
+        float v = 16 + i * 15;
+        GPoint horz[] = { {16, v}, {256, v} };
+        GPoint vert[] = { {v, 16}, {v, 256} };
+        canvas->drawHairlines(horz, 2, gridPaint);
+        canvas->drawHairlines(vert, 2, gridPaint);
+    }
+
+    // a fan, in every direction
+    const GPoint c = { 384, 136 };
+    for (int i = 0; i < 48; ++i) {
+        float angle = float(i * 2 * M_PI / 48);
+        GPoint pts[] = { c, { c.fX + 110 * cosf(angle), c.fY + 110 * sinf(angle) } };
+        canvas->drawHairlines(pts, 2, paint);
+    }
+
+    // a polyline under a rotation, stays one pixel wide
+    GPoint wave[40];
+    for (int i = 0; i < 40; ++i) {
+        wave[i] = { i * 10.0f, 40 * sinf(i * 0.4f) };
+    }
+    canvas->save();
+    canvas->translate(60, 340);
+    canvas->rotate(0.2f);
+    canvas->drawHairlines(wave, 40, paint);
+    canvas->restore();
+
+    // translucent, so a joint drawn twice would show
+    GPoint zigzag[] = { {40, 470}, {120, 400}, {200, 470}, {280, 400}, {360, 470}, {440, 400} };
+    canvas->drawHairlines(zigzag, GARRAY_COUNT(zigzag), GPaint({0, 0, 0, 0.5f}));
+}
+
+////////
+
+static void draw_dashed(GFinal* fin, GCanvas* canvas, const GPath& src, const float intervals[],
+                        int count, float phase, float width, GFinal::CapType cap,
+                        const GColor& color) {
+    GPath dashes, stroke;
+    fin->dashPath(&dashes, src, intervals, count, phase);
+    fin->strokePath(&stroke, dashes, width, cap, GFinal::kRoundJoin);
+    canvas->drawPath(stroke, GPaint(color));
+}
+
+static bool nearly_equal(float a, float b) {
+    return fabsf(a - b) < 0.001f;
+}
+
+// Answers worked out by hand, checked before the drawing that depends on them.
+static void check_dash_answers(GFinal* fin) {
+    // a 100 long line, 20 on 10 off, starting 5 in: dashes over [0,15] [25,45] [55,75] [85,100]
+    GPath line, dashes;
+    line.moveTo({0, 0}).lineTo({100, 0});
+    const float intervals[] = { 20, 10 };
+    fin->dashPath(&dashes, line, intervals, 2, 5);
+
+    GPathMeasure measure(dashes);
+    const float starts[] = { 0, 25, 55, 85 };
+    const float lengths[] = { 15, 20, 20, 15 };
+    assert(measure.countContours() == 4);
+    assert(dashes.countPoints() == 8);
+    for (int i = 0; i < 4; ++i) {
+        assert(nearly_equal(measure.length(i), lengths[i]));
+        assert(nearly_equal(dashes.points()[i * 2].fX, starts[i]));
+    }
+
+    // a phase a whole pattern further on draws the same dashes
+    GPath wrapped;
+    fin->dashPath(&wrapped, line, intervals, 2, 35);
+    assert(wrapped.countPoints() == 8);
+    for (int i = 0; i < 8; ++i) {
+        assert(nearly_equal(wrapped.points()[i].fX, dashes.points()[i].fX));
+    }
+
+    // curves are measured to within the chord tolerance: a circle's circumference is 2 pi r
+    GPath circle;
+    circle.addCircle({0, 0}, 90);
+    assert(fabsf(GPathMeasure(circle).length(0) - float(2 * M_PI * 90)) < 0.5f);
+}
+
+static void final_dash(GCanvas* canvas) {
+    auto fin = GCreateFinal();
+    check_dash_answers(fin.get());
+
+    // round dots from zero-length dashes, the first on the start of the line at phase 0
+    const float dots[] = { 0, 16 };
+    for (int i = 0; i < 4; ++i) {
+        GPath line;
+        line.moveTo({32, 32 + i * 24.0f}).lineTo({480, 32 + i * 24.0f});
+        draw_dashed(fin.get(), canvas, line, dots, 2, i * 4, 8, GFinal::kRound, {0, 0, 0, 1});
+    }
+
+    // dashes around a circle, with a long and short pattern
+    const float dashDot[] = { 24, 8, 0, 8 };
+    GPath circle;
+    circle.addCircle({128, 270}, 90);
+    draw_dashed(fin.get(), canvas, circle, dashDot, 4, 0, 6, GFinal::kRound, {0.8f, 0.1f, 0.1f, 1});
+
+    // dashes along curves keep their lengths around the bends
+    const float dash[] = { 20, 10 };
+    GPath wave;
+    wave.moveTo({260, 220});
+    wave.quadTo({310, 120}, {360, 220});
+    wave.cubicTo({400, 320}, {440, 120}, {490, 220});
+    draw_dashed(fin.get(), canvas, wave, dash, 2, 0, 8, GFinal::kButt, {0.1f, 0.3f, 0.9f, 1});
+
+    // the pattern moving along with the phase, under a rotation
+    canvas->save();
+    canvas->translate(300, 330);
+    canvas->rotate(0.3f);
+    for (int i = 0; i < 5; ++i) {
+        GPath line;
+        line.moveTo({0, i * 22.0f}).lineTo({170, i * 22.0f});
+        draw_dashed(fin.get(), canvas, line, dash, 2, i * 6, 6, GFinal::kSquare,
+                    {0.1f, 0.6f, 0.2f, 1});
+    }
+    canvas->restore();
+}
+
+////////
+
+static void draw_rings(GCanvas* canvas, GPoint c, float alpha) {
+    const GColor colors[] = { {1,0,0,1}, {0,0.7f,0,1}, {0,0,1,1} };
+    for (int i = 0; i < 3; ++i) {
+        float angle = float(i * 2 * M_PI / 3);
+        GPath path;
+        path.addCircle({ c.fX + 36 * cosf(angle), c.fY + 36 * sinf(angle) }, 56);
+        GColor color = colors[i];
+        color.a = alpha;
+        canvas->drawPath(path, GPaint(color));
+    }
+}
+
+// Answers worked out by hand, checked on a small bitmap before drawing.
+static void check_layer_answers() {
+    GPixel pixels[16 * 16];
+    GBitmap bm(16, 16, 16 * sizeof(GPixel), pixels, false);
+    auto canvas = GCreateCanvas(bm);
+
+    // opaque red in a 50% layer over white: the layer is scaled by 128 (.5 * 255 rounded), then
+    // red and alpha are 128 + 127 = 255 and green and blue are the white's 255 * 127/255 = 127
+    canvas->clear({1, 1, 1, 1});
+    canvas->saveLayer(nullptr, GPaint({0, 0, 0, 0.5f}));
+    canvas->fillRect(GRect::WH(16, 16), {1, 0, 0, 1});
+    canvas->restore();
+    assert(*bm.getAddr(8, 8) == GPixel_PackARGB(255, 255, 127, 127));
+
+    // layers nested past the pool's 4 buffers, twice over, so the second time reuses the pooled
+    // buffers: each must start out transparent again, not with what the first time drew in it
+    const GRect halves[] = { GRect::LTRB(0, 0, 8, 16), GRect::LTRB(8, 0, 16, 16) };
+    for (int i = 0; i < 2; ++i) {
+        canvas->clear({1, 1, 1, 1});
+        for (int depth = 0; depth < 6; ++depth) {
+            canvas->saveLayer(nullptr, GPaint());
+        }
+        canvas->fillRect(halves[i], {0, 0, 1, 1});
+        for (int depth = 0; depth < 6; ++depth) {
+            canvas->restore();
+        }
+        assert(*bm.getAddr(4 + i * 8, 8) == GPixel_PackARGB(255, 0, 0, 255));
+        assert(*bm.getAddr(12 - i * 8, 8) == GPixel_PackARGB(255, 255, 255, 255));
+    }
+}
+
+static void final_layers(GCanvas* canvas) {
+    check_layer_answers();
+
+    canvas->clear({1, 1, 1, 1});
+
+    // each circle at half alpha, where they overlap darker...
+    draw_rings(canvas, {128, 128}, 0.5f);
+
+    // ...than the group faded as one
+    canvas->saveLayer(nullptr, GPaint({0, 0, 0, 0.5f}));
+    draw_rings(canvas, {384, 128}, 1);
+    canvas->restore();
+
+    // bounds clip the layer, under the CTM
+    const GRect bounds = GRect::LTRB(-80, -40, 80, 40);
+    canvas->save();
+    canvas->translate(128, 384);
+    canvas->rotate(0.4f);
+    canvas->saveLayer(&bounds, GPaint({0, 0, 0, 0.75f}));
+    canvas->rotate(-0.4f);
+    draw_rings(canvas, {0, 0}, 1);
+    canvas->restore();
+    canvas->restore();
+
+    // a nested layer knocks a hole in its parent with its blendmode
+    GPaint knockout({0, 0, 0, 1});
+    knockout.setBlendMode(GBlendMode::kDstOut);
+    canvas->saveLayer(nullptr, GPaint({0, 0, 0, 0.8f}));
+    draw_rings(canvas, {384, 384}, 1);
+    const GRect hole = GRect::XYWH(354, 354, 60, 60);
+    canvas->saveLayer(&hole, knockout);
+    canvas->drawPaint(GPaint({0, 0, 0, 1}));
+    canvas->restore();
+    canvas->restore();
+}
+
+////////
+
+static void final_mesh_alpha(GCanvas* canvas) {
+    canvas->clear({1, 1, 1, 1});
+
+    // stripes to show through
+    for (int i = 0; i < 16; ++i) {
+        canvas->fillRect(GRect::XYWH(0, i * 32.0f, 512, 16), {0.2f, 0.2f, 0.2f, 1});
+    }
+
+    // a fan of colored triangles, faded more in each corner
+    const GColor colors[] = { {1,0,0,1}, {0,1,0,1}, {0,0,1,1}, {1,1,0,1}, {1,1,1,1} };
+    const float alphas[] = { 1, 0.75f, 0.5f, 0.25f };
+    for (int k = 0; k < 4; ++k) {
+        float x = (k & 1) * 256.0f + 128;
+        float y = (k >> 1) * 256.0f + 128;
+        GPoint verts[] = { {x-100, y-100}, {x+100, y-100}, {x+100, y+100}, {x-100, y+100}, {x, y} };
+        const int indices[] = { 4, 0, 1,  4, 1, 2,  4, 2, 3,  4, 3, 0 };
+        canvas->drawMesh(verts, colors, nullptr, 4, indices, GPaint({0, 0, 0, alphas[k]}));
+    }
+}
+
+////////
+
+static void draw_textured_quad(GCanvas* canvas, const GBitmap& bm, GPoint origin, bool perspective,
+                               GCanvas::FilterMode filter) {
+    // a floor tilting away from the viewer: the far edge is 2.5 times as deep as the near one,
+    // and stretched back up so it fills about as much of its cell
+    const float ws[] = { 2.5f, 2.5f, 1, 1 };
+    const float depth = perspective ? 1.6f : 1;
+    GPoint verts[4];
+    for (int i = 0; i < 4; ++i) {
+        float x = (i == 1 || i == 2) ? 100 : -100;
+        float y = i < 2 ? -100 : 100;
+        float w = perspective ? ws[i] : 1;
+        verts[i] = { origin.fX + x / w, origin.fY + 100 + (y - 100) * depth / w };
+    }
+
+    const GPoint texs[] = {
+        { 0, 0 }, { float(bm.width()), 0 }, { float(bm.width()), float(bm.height()) },
+        { 0, float(bm.height()) },
+    };
+    const int indices[] = { 0, 1, 3,  1, 2, 3 };
+    canvas->drawTexturedMesh(verts, perspective ? ws : nullptr, texs, 2, indices, bm, filter,
+                             GPaint());
+}
+
+static void final_textured_mesh(GCanvas* canvas) {
+    // a small checkerboard, magnified so the filters differ and the squares show the perspective
+    GPixel pixels[64];
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            pixels[y * 8 + x] = ((x + y) & 1) ? 0xFF2040C0 : 0xFFF0E0A0 - (x * 0x101000);
+        }
+    }
+    GBitmap bm(8, 8, 8*sizeof(GPixel), pixels, true);
+
+    // nearest on the left, bilinear on the right; flat on top, in perspective below
+    draw_textured_quad(canvas, bm, {128, 128}, false, GCanvas::kNearest);
+    draw_textured_quad(canvas, bm, {384, 128}, false, GCanvas::kBilinear);
+    draw_textured_quad(canvas, bm, {128, 384}, true, GCanvas::kNearest);
+    draw_textured_quad(canvas, bm, {384, 384}, true, GCanvas::kBilinear);
+}
+
+////////
+
+static void final_composite_shaders(GCanvas* canvas) {
+    // stripes, so anything not opaque shows them through
+    canvas->clear({1, 1, 1, 1});
+    for (int i = 0; i < 32; ++i) {
+        canvas->fillRect(GRect::XYWH(i * 16.0f, 0, 8, 512), {0.3f, 0.3f, 0.3f, 1});
+    }
+
+    // one gradient the same on every row, one the same on every column, and a translucent one
+    const GColor across[] = { {1,0,0,1}, {1,1,0,1}, {0,0,1,1} };
+    const GColor down[] = { {0,1,1,1}, {1,0,1,1} };
+    const GColor fading[] = { {0,0,0,1}, {0,0.6f,0,0.2f} };
+    auto horz = GCreateLinearGradient({0, 0}, {150, 0}, across, 3, GShader::kClamp);
+    auto vert = GCreateLinearGradient({0, 0}, {0, 150}, down, 2, GShader::kClamp);
+    auto fade = GCreateLinearGradient({0, 0}, {0, 150}, fading, 2, GShader::kClamp);
+
+    // some stay opaque, some let the stripes through, some vary both ways from parts that don't
+    std::unique_ptr<GShader> shaders[] = {
+        GCreateMultiplyShader(horz.get(), vert.get()),
+        GCreateMultiplyShader(horz.get(), fade.get()),
+        GCreateComposeShader(horz.get(), fade.get(), GBlendMode::kSrcOver),
+        GCreateComposeShader(horz.get(), fade.get(), GBlendMode::kDstOut),
+        GCreateComposeShader(vert.get(), fade.get(), GBlendMode::kSrcATop),
+        GCreateColorFilterShader(horz.get(), {0, 0, 1, 0.5f}, GBlendMode::kSrcATop),
+        GCreateColorFilterShader(vert.get(), {0, 0, 0, 0.5f}, GBlendMode::kDstIn),
+        GCreateAlphaShader(horz.get(), 0.5f),
+        GCreateAlphaShader(fade.get(), 1),
+    };
+
+    const GRect r = GRect::WH(150, 150);
+    for (int i = 0; i < 9; ++i) {
+        assert(shaders[i]);
+        canvas->save();
+        canvas->translate(16 + (i % 3) * 165.0f, 16 + (i / 3) * 165.0f);
+        canvas->drawRect(r, GPaint(shaders[i].get()));
+        canvas->restore();
+    }
+}
+
+////////
+
+static void final_joins(GCanvas* canvas) {
+    auto fin = GCreateFinal();
+
+    // corners of 100, 30 and 10 degrees: the 30 degree miter is within the default limit of 4,
+    // the 10 degree one is past it and falls back to a bevel
+    const float halfAngles[] = { 50, 15, 5 };
+    const float apexes[] = { 105, 235, 305 };
+    const GPoint triangle[] = { {345, 80}, {465, 80}, {355, 10} };
+
+    const struct {
+        GFinal::JoinType join;
+        GColor color;
+    } recs[] = {
+        { GFinal::kMiterJoin, {0.8f, 0.1f, 0.1f, 1} },
+        { GFinal::kRoundJoin, {0.1f, 0.6f, 0.2f, 1} },
+        { GFinal::kBevelJoin, {0.1f, 0.3f, 0.9f, 1} },
+    };
+    for (int i = 0; i < 3; ++i) {
+        canvas->save();
+        canvas->translate(0, 50 + i * 160.0f);
+
+        // open polylines get butt caps, a closed one has a join where it meets itself
+        GPath path, stroke;
+        for (int j = 0; j < 3; ++j) {
+            float dx = 80 * tanf(halfAngles[j] * float(M_PI) / 180);
+            GPoint pts[] = { {apexes[j] - dx, 80}, {apexes[j], 0}, {apexes[j] + dx, 80} };
+            path.moveTo(pts[0]).lineTo(pts[1]).lineTo(pts[2]);
+            canvas->drawHairlines(pts, 3, GPaint({0, 0, 0, 1}));
+        }
+        path.moveTo(triangle[0]).lineTo(triangle[1]).lineTo(triangle[2]).lineTo(triangle[0]);
+        fin->strokePath(&stroke, path, 12, GFinal::kButt, recs[i].join);
+
+        // translucent, so the centerlines show how far each join reaches past its corner
+        GColor color = recs[i].color;
+        color.a = 0.7f;
+        canvas->drawPath(stroke, GPaint(color));
+        canvas->restore();
+    }
+}
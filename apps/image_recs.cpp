@@ -9,6 +9,13 @@ const GDrawRec gDrawRecs[] = {
     { final_radial, 512, 512, "final_radial", 0 },
     { final_stroke, 512, 512, "final_stroke", 0 },
     { final_coons, 512, 512, "final_coons", 0 },
+    { final_hairlines, 512, 512, "final_hairlines", 0 },
+    { final_dash, 512, 512, "final_dash", 0 },
+    { final_layers, 512, 512, "final_layers", 0 },
+    { final_mesh_alpha, 512, 512, "final_mesh_alpha", 0 },
+    { final_textured_mesh, 512, 512, "final_textured_mesh", 0 },
+    { final_composite_shaders, 512, 512, "final_composite_shaders", 0 },
+    { final_joins, 512, 512, "final_joins", 0 },
 
     { nullptr, 0, 0, nullptr },
 };
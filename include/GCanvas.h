@@ -37,6 +37,18 @@ public:
      */
     virtual void restore() = 0;
 
+    /**
+     *  Like save(), but until the balancing restore() everything is drawn into an offscreen
+     *  layer, which starts out transparent. restore() then blends the layer back onto the canvas
+     *  with the paint's alpha and blendmode (its color and shader are ignored), so a group of
+     *  draws can be faded or blended as one.
+     *
+     *  If bounds is not null, the layer only covers the pixels whose centers are inside bounds
+     *  mapped by the CTM (or the box around it, if rotated), and drawing outside it is discarded.
+     *  Else it covers the whole canvas.
+     */
+    virtual void saveLayer(const GRect* bounds, const GPaint&) = 0;
+
     /**
      *  Modifies the CTM by preconcatenating the specified matrix with the CTM. The canvas
      *  is constructed with an identity CTM.
@@ -97,6 +109,8 @@ public:
      *
      *  If both colors and texs[] are specified, then at each pixel their values are multiplied
      *  together, component by component.
+     *
+     *  The paint's alpha and blendmode are used, whether the mesh has colors, texs or both.
      */
     virtual void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
                           int count, const int indices[], const GPaint&) = 0;
@@ -122,6 +136,38 @@ public:
     virtual void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4],
                           int level, const GPaint&) = 0;
 
+    enum FilterMode {
+        kNearest,   // the texel containing the sample point
+        kBilinear,  // the 4 texels around the sample point, weighted by distance
+    };
+
+    /**
+     *  Draw a mesh of triangles textured straight from a bitmap, rather than through the paint's
+     *  shader. verts, texs and indices are specified as in drawMesh(). texs are in the bitmap's
+     *  pixel space, and samples outside the bitmap clamp to its edge.
+     *
+     *  If ws is not null, each vertex also has a homogeneous w (e.g. its depth after a perspective
+     *  projection, with verts already divided by it), and texture coordinates are interpolated
+     *  perspective-correctly: texs/w and 1/w are interpolated across the triangle and divided at
+     *  each pixel. Every w must be > 0.
+     *
+     *  The paint's alpha and blendmode are used; its color and shader are ignored.
+     */
+    virtual void drawTexturedMesh(const GPoint verts[], const float ws[], const GPoint texs[],
+                                  int count, const int indices[], const GBitmap& texture,
+                                  FilterMode, const GPaint&) = 0;
+
+    /**
+     *  Draw lines one device pixel wide (whatever the CTM) from pts[0] to pts[1], pts[1] to
+     *  pts[2], ... pts[count-2] to pts[count-1], without filling a path.
+     *
+     *  Along each line's major axis, the pixels whose centers the line spans are drawn, one per
+     *  column (or row), in the row (or column) the line crosses that center in. So a line covers
+     *  the same pixels in either direction, and lines that meet end to end don't draw the pixel
+     *  at the joint twice. The paint's color or shader, alpha and blendmode are used.
+     */
+    virtual void drawHairlines(const GPoint pts[], int count, const GPaint&) = 0;
+
     // Helpers
 
     void translate(float x, float y) {
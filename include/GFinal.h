@@ -56,6 +56,25 @@ public:
      */
     virtual void addLine(GPath* path, GPoint p0, GPoint p1, float width, CapType) {}
 
+    enum JoinType {
+        kMiterJoin,     // extend the sides until they meet, unless that is past the miter limit
+        kRoundJoin,     // round join with radius = width/2
+        kBevelJoin,     // connect the sides with a straight line
+    };
+
+    /**
+     *  Add contour(s) to dst that will draw src stroked with the specified width, CapType and
+     *  JoinType. Each contour of src may have any mix of lines, quads and cubics. A contour that
+     *  ends where it started is treated as closed (joined to itself, no caps). Miter joins longer
+     *  than miterLimit * width/2 are drawn as bevels.
+     */
+    virtual void strokePath(GPath* dst, const GPath& src, float width, CapType, JoinType,
+                            float miterLimit = 4) {}
+
+    // Add to dst the dashes of src, ready for strokePath(). See dashPath() in GPathMeasure.h.
+    virtual void dashPath(GPath* dst, const GPath& src, const float intervals[], int count,
+                          float phase) {}
+
     /*
      *  Draw the corresponding mesh constructed from a quad with each side defined by a
      *  quadratic bezier, evaluating them to produce "level" interior lines (same convention
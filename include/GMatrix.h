@@ -19,6 +19,7 @@ public:
     GMatrix(float a, float b, float c, float d, float e, float f) {
         fMat[0] = a;    fMat[1] = b;    fMat[2] = c;
         fMat[3] = d;    fMat[4] = e;    fMat[5] = f;
+        fTypeMask = this->computeTypeMask();
     }
 
     GMatrix(const GMatrix& other) = default;
@@ -27,9 +28,53 @@ public:
         assert(index >= 0 && index < 6);
         return fMat[index];
     }
-    float& operator[](int index) {
+    void set(int index, float value) {
         assert(index >= 0 && index < 6);
-        return fMat[index];
+        fMat[index] = value;
+        fTypeMask = this->computeTypeMask();
+    }
+
+    /**
+     *  A writable entry. It reads like a float, and writing it (m[i] = v, m[i] += v, ...) goes
+     *  through set(), so the cached type stays right. Reading an entry leaves the type alone.
+     */
+    class Entry {
+    public:
+        operator float() const { return fMatrix->fMat[fIndex]; }
+        Entry& operator=(float value) { fMatrix->set(fIndex, value); return *this; }
+        Entry& operator=(const Entry& other) { return *this = float(other); }
+        Entry& operator+=(float value) { return *this = float(*this) + value; }
+        Entry& operator-=(float value) { return *this = float(*this) - value; }
+        Entry& operator*=(float value) { return *this = float(*this) * value; }
+        Entry& operator/=(float value) { return *this = float(*this) / value; }
+
+    private:
+        friend class GMatrix;
+        Entry(GMatrix* matrix, int index) : fMatrix(matrix), fIndex(index) {}
+
+        GMatrix* fMatrix;
+        int      fIndex;
+    };
+
+    Entry operator[](int index) {
+        assert(index >= 0 && index < 6);
+        return Entry(this, index);
+    }
+
+    /**
+     *  What the matrix does, as a combination of these bits. A matrix with no bits set is the
+     *  identity. kAffine_Mask means b or d is nonzero (rotation or skew), and is the only case
+     *  where x' depends on y or y' on x.
+     */
+    enum TypeMask {
+        kIdentity_Mask  = 0,
+        kTranslate_Mask = 1 << 0,   // c or f is nonzero
+        kScale_Mask     = 1 << 1,   // a or e is not 1
+        kAffine_Mask    = 1 << 2,   // b or d is nonzero
+    };
+
+    unsigned getType() const {
+        return fTypeMask;
     }
 
     bool operator==(const GMatrix& m) {
@@ -107,7 +152,22 @@ public:
     }
 
 private:
-    float fMat[6];
+    unsigned computeTypeMask() const {
+        unsigned mask = kIdentity_Mask;
+        if (fMat[2] != 0 || fMat[5] != 0) {
+            mask |= kTranslate_Mask;
+        }
+        if (fMat[0] != 1 || fMat[4] != 1) {
+            mask |= kScale_Mask;
+        }
+        if (fMat[1] != 0 || fMat[3] != 0) {
+            mask |= kAffine_Mask;
+        }
+        return mask;
+    }
+
+    float   fMat[6];
+    uint8_t fTypeMask;
 };
 
 #endif
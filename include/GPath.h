@@ -1,6 +1,9 @@
 #ifndef GPath_DEFINED
 #define GPath_DEFINED
 
+#include <atomic>
+#include <memory>
+#include <stdint.h>
 #include <vector>
 #include "GMatrix.h"
 #include "GPoint.h"
@@ -23,8 +26,9 @@ public:
      *  Returns a reference to this path.
      */
     GPath& moveTo(GPoint p) {
-        fPts.push_back(p);
-        fVbs.push_back(kMove);
+        Storage& storage = this->edit();
+        storage.fPts.push_back(p);
+        storage.fVbs.push_back(kMove);
         return *this;
     }
     GPath& moveTo(float x, float y) { return this->moveTo({x, y}); }
@@ -35,9 +39,10 @@ public:
      *  Returns a reference to this path.
      */
     GPath& lineTo(GPoint p) {
-        assert(fVbs.size() > 0);
-        fPts.push_back(p);
-        fVbs.push_back(kLine);
+        assert(fStorage->fVbs.size() > 0);
+        Storage& storage = this->edit();
+        storage.fPts.push_back(p);
+        storage.fVbs.push_back(kLine);
         return *this;
     }
     GPath& lineTo(float x, float y) { return this->lineTo({x, y}); }
@@ -85,7 +90,16 @@ public:
      */
     void addCircle(GPoint center, float radius, Direction = kCW_Direction);
 
-    int countPoints() const { return (int)fPts.size(); }
+    int countPoints() const { return (int)fStorage->fPts.size(); }
+    const GPoint* points() const { return fStorage->fPts.data(); }
+
+    /**
+     *  Return an ID for the path's current contents. Two paths (or the same path at two times)
+     *  with the same ID have the same points and verbs, so it can key caches of work derived from
+     *  the path. Copies share their ID until one is edited; editing gives the path a new ID.
+     *  Never returns 0.
+     */
+    uint32_t genID() const;
 
     /**
      *  Return the bounds of all of the control-points in the path.
@@ -94,6 +108,21 @@ public:
      */
     GRect bounds() const;
 
+    enum Shape {
+        kRect_Shape,    // one axis-aligned rectangle contour (e.g. from addRect)
+        kOval_Shape,    // one circle contour, from addCircle on an empty path
+        kConvex_Shape,  // one convex contour of lines
+        kGeneral_Shape, // anything else, including empty paths
+    };
+
+    /**
+     *  Return what kind of shape the path is. Like bounds(), this is worked out the first time
+     *  it is asked for after an edit and remembered until the next edit.
+     */
+    Shape shape() const;
+
+    bool isConvex() const { return this->shape() != kGeneral_Shape; }
+
     /**
      *  Transform the path in-place by the specified matrix.
      */
@@ -160,6 +189,9 @@ public:
     class Edger {
     public:
         Edger(const GPath&);
+        // Walk the path's verbs over pts[] (countPoints() of them, e.g. the path's points
+        // already mapped to device space) instead of over the path's own points.
+        Edger(const GPath&, const GPoint pts[]);
         Verb next(GPoint pts[]);
 
     private:
@@ -189,8 +221,32 @@ public:
     void dump() const;
 
 private:
-    std::vector<GPoint> fPts;
-    std::vector<Verb>   fVbs;
+    /**
+     *  Points, verbs and generation ID. Copies of a path share one Storage, so copying is cheap;
+     *  shared storage is never modified, and a path copies it before its first edit. An ID of 0
+     *  means none has been handed out since the last edit.
+     */
+    struct Storage {
+        std::vector<GPoint>   fPts;
+        std::vector<Verb>     fVbs;
+        std::atomic<uint32_t> fGenID{0};
+        bool                  fIsCircle = false;   // set by addCircle() on an empty path
+
+        // Lazily computed by analyze(). fAnalysis is 0 until they are wanted, 1 while one caller
+        // stores them, and 2 once they can be read.
+        std::atomic<int>      fAnalysis{0};
+        GRect                 fBounds;
+        Shape                 fShape;
+    };
+
+    // Compute (or recall) the bounds and shape of the storage's points and verbs.
+    void analyze(GRect* bounds, Shape* shape) const;
+
+    // Return storage this path can modify (unshared, copying it if needed), and clear its ID and
+    // analysis.
+    Storage& edit();
+
+    std::shared_ptr<Storage> fStorage;
 };
 
 #endif
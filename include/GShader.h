@@ -6,6 +6,7 @@
 #define GShader_DEFINED
 
 #include <memory>
+#include "GBlendMode.h"
 #include "GColor.h"
 #include "GPixel.h"
 #include "GPoint.h"
@@ -32,6 +33,28 @@ public:
     // The draw calls in GCanvas must call this with the CTM before any calls to shadeSpan().
     virtual bool setContext(const GMatrix& ctm) = 0;
 
+    /**
+     *  Same as setContext(ctm), given the CTM's inverse as well. The canvas keeps the inverse with
+     *  the CTM, so shaders that map device points back to their own space can use it instead of
+     *  inverting the CTM on every draw. The default ignores the inverse.
+     */
+    virtual bool setContext(const GMatrix& ctm, const GMatrix& inverse) {
+        return this->setContext(ctm);
+    }
+
+    enum Invariance {
+        kNone_Invariance = 0,
+        kX_Invariance    = 1 << 0,  // constant along x: every row is a single color
+        kY_Invariance    = 1 << 1,  // constant along y: every row is the same
+    };
+
+    /**
+     *  Return a mask of Invariance bits for the current context (valid after setContext()).
+     *  Draw calls use this to shade one pixel per row, or one row per draw, instead of every
+     *  pixel.
+     */
+    virtual int invariance() { return kNone_Invariance; }
+
     /**
      *  Given a row of pixels in device space [x, y] ... [x + count - 1, y], return the
      *  corresponding src pixels in row[0...count - 1]. The caller must ensure that row[]
@@ -61,6 +84,31 @@ std::unique_ptr<GShader> GCreateBitmapShader(const GBitmap&, const GMatrix& loca
 std::unique_ptr<GShader> GCreateLinearGradient(GPoint p0, GPoint p1, const GColor[], int count,
                                                GShader::TileMode = GShader::kClamp);
 
+/**
+ *  Return a shader whose output is the component-wise product of the two shaders' (premul)
+ *  outputs, e.g. a gradient tinting a bitmap. The result does not own either shader, so they
+ *  must outlive it. Returns null if either shader is null.
+ */
+std::unique_ptr<GShader> GCreateMultiplyShader(GShader* a, GShader* b);
+
+/**
+ *  Return a shader that blends the output of src onto the output of dst with the blend mode,
+ *  as if src were drawn over dst. The result does not own either shader.
+ */
+std::unique_ptr<GShader> GCreateComposeShader(GShader* dst, GShader* src, GBlendMode);
+
+/**
+ *  Return a shader that blends the (unpremul) color onto the shader's output with the blend
+ *  mode, i.e. a color filter. The result does not own the shader.
+ */
+std::unique_ptr<GShader> GCreateColorFilterShader(GShader*, const GColor&, GBlendMode);
+
+/**
+ *  Return a shader that scales the shader's output by alpha (0...1). The result does not own
+ *  the shader.
+ */
+std::unique_ptr<GShader> GCreateAlphaShader(GShader*, float alpha);
+
 static inline std::unique_ptr<GShader>
 GCreateLinearGradient(GPoint p0, GPoint p1,
                       const GColor& c0, const GColor& c1,
@@ -5,23 +5,32 @@
 #include "../include/GPath.h"
 #include "../include/GMatrix.h"
 
-GPath::GPath() {}
+GPath::GPath() : fStorage(std::make_shared<Storage>()) {}
 GPath::~GPath() {}
 
 GPath& GPath::operator=(const GPath& src) {
-    if (this != &src) {
-        fPts = src.fPts;
-        fVbs = src.fVbs;
-    }
+    fStorage = src.fStorage;
     return *this;
 }
 
 GPath& GPath::reset() {
-    fPts.clear();
-    fVbs.clear();
+    fStorage = std::make_shared<Storage>();
     return *this;
 }
 
+GPath::Storage& GPath::edit() {
+    if (fStorage.use_count() > 1) {
+        std::shared_ptr<Storage> copy = std::make_shared<Storage>();
+        copy->fPts = fStorage->fPts;
+        copy->fVbs = fStorage->fVbs;
+        fStorage = copy;
+    }
+    fStorage->fGenID = 0;
+    fStorage->fIsCircle = false;
+    fStorage->fAnalysis = 0;
+    return *fStorage;
+}
+
 void GPath::dump() const {
     Iter iter(*this);
     GPoint pts[GPath::kMaxNextPoints];
@@ -48,29 +57,44 @@ void GPath::dump() const {
 }
 
 GPath& GPath::quadTo(GPoint p1, GPoint p2) {
-    assert(fVbs.size() > 0);
-    fPts.push_back(p1);
-    fPts.push_back(p2);
-    fVbs.push_back(kQuad);
+    assert(fStorage->fVbs.size() > 0);
+    Storage& storage = this->edit();
+    storage.fPts.push_back(p1);
+    storage.fPts.push_back(p2);
+    storage.fVbs.push_back(kQuad);
     return *this;
 }
 
 GPath& GPath::cubicTo(GPoint p1, GPoint p2, GPoint p3) {
-    assert(fVbs.size() > 0);
-    fPts.push_back(p1);
-    fPts.push_back(p2);
-    fPts.push_back(p3);
-    fVbs.push_back(kCubic);
+    assert(fStorage->fVbs.size() > 0);
+    Storage& storage = this->edit();
+    storage.fPts.push_back(p1);
+    storage.fPts.push_back(p2);
+    storage.fPts.push_back(p3);
+    storage.fVbs.push_back(kCubic);
     return *this;
 }
 
+uint32_t GPath::genID() const {
+    static std::atomic<uint32_t> gNextID(1);
+    uint32_t id = fStorage->fGenID.load();
+    while (id == 0) {
+        uint32_t next = gNextID++;
+        // if another copy sharing the storage got there first, id picks up its value
+        if (next != 0 && fStorage->fGenID.compare_exchange_strong(id, next)) {
+            id = next;
+        }
+    }
+    return id;
+}
+
 /////////////////////////////////////////////////////////////////
 
 GPath::Iter::Iter(const GPath& path) {
     fPrevMove = nullptr;
-    fCurrPt = path.fPts.data();
-    fCurrVb = path.fVbs.data();
-    fStopVb = fCurrVb + path.fVbs.size();
+    fCurrPt = path.fStorage->fPts.data();
+    fCurrVb = path.fStorage->fVbs.data();
+    fStopVb = fCurrVb + path.fStorage->fVbs.size();
 }
 
 GPath::Verb GPath::Iter::next(GPoint pts[]) {
@@ -105,11 +129,13 @@ GPath::Verb GPath::Iter::next(GPoint pts[]) {
     return v;
 }
 
-GPath::Edger::Edger(const GPath& path) {
+GPath::Edger::Edger(const GPath& path) : Edger(path, path.fStorage->fPts.data()) {}
+
+GPath::Edger::Edger(const GPath& path, const GPoint pts[]) {
     fPrevMove = nullptr;
-    fCurrPt = path.fPts.data();
-    fCurrVb = path.fVbs.data();
-    fStopVb = fCurrVb + path.fVbs.size();
+    fCurrPt = pts;
+    fCurrVb = path.fStorage->fVbs.data();
+    fStopVb = fCurrVb + path.fStorage->fVbs.size();
     fPrevVerb = kDone;
 }
 
@@ -119,7 +145,7 @@ GPath::Verb GPath::Edger::next(GPoint pts[]) {
     while (fCurrVb < fStopVb) {
         switch (*fCurrVb++) {
             case kMove:
-                if (fPrevVerb == kLine) {
+                if (fPrevVerb >= kLine && fPrevVerb <= kCubic) {
                     pts[0] = fCurrPt[-1];
                     pts[1] = *fPrevMove;
                     do_return = true;